@@ -5,13 +5,14 @@
 
 // Import the MapInfo header file, which takes care of other imports
 #include "oia_risk_model/mif.h"
+#include "oia_risk_model/raster_stack.h"
 
 // Alias the imported namespace, to make it a little easier to use...
 namespace oia = oia_risk_model;
 
 /*
  * This application is used to add exposure data to assets, for multiple sources. 
- * Suggested compilation script: g++ asset_exposure.cpp -std=c++17 -O3 -o asset_exposure 
+ * Suggested compilation script: g++ asset_exposure.cpp -std=c++17 -O3 -march=native -pthread -o asset_exposure
  */
 int main(int argc, char** argv){
   /////////////////////////////////////////////////////////
@@ -42,51 +43,54 @@ int main(int argc, char** argv){
 
 
   ///////////////////////////////////////////////////////
-  // 2: Read and prepare the assets for exposure calcs...
-  oia::MIF assets(mifFile);
+  // 2: Read and prepare the assets for exposure calcs (keeping a binary copy, so subsequent runs needn't parse the text)...
+  oia::MIF assets(mifFile, false, 0, true);
 
   // Divide the assets onto the hazards (but don't bother recording the fact we are dividing the assets)...
-  assets.divideFeatures(rasterFiles.at(0).first, false);
+  assets.divideFeatures(oia::Ascii(rasterFiles.at(0).first, true), false);
 
 
   ///////////////////////////////////////////////////////////////////////////////////////////////////////
-  // 3: Calculate per-raster exposure (Note: this process needs to be run buffered i.e. out-of-memory)...
-  std::vector<double>       buffer;       // A buffer of data into which to save the exposure calcs
-  std::vector<std::string>  bufferFiles;  // A vector of attribute names, which are being used as file-names for buffered file creation
-
-  // Loop over all the rasters...
-  for(auto rasterFile : rasterFiles){
-    // Wipe-out the old data in the buffer...
-    buffer.resize(assets.features.size(),0);
-
-    // Read the raster...
-    oia::Ascii ascii(rasterFile.first);
-
-    // Loop over all the features in the mif file...
-    int featureIndex=0;
-    for(auto f : assets.features){
-
-      // Recover the cell index at the mid-point of the first feature...
-      oia::geometry::Vec2<double> midPoint = f.mid_point();
-
-      // Add the data to the buffer...
-      buffer.at(featureIndex) = ascii.data_at_point(midPoint); // Add the data to the feature index...
-
-      // Increment the count of features...
-      featureIndex++;
+  // 3: Calculate per-raster exposure (Note: the exposure is buffered out-of-memory, but the hazards are not)...
+  // Read all the rasters into a single stack held in memory (numBands*cells*4 bytes), so each feature is only looked up once...
+  oia::RasterStack hazards(rasterFiles, true);
+
+  // Buffer the exposure in a scratch matrix on disk, with a column for each raster (which starts out as all zeros)...
+  oia::utils::ScratchMatrix exposure(assets.features.size(), hazards.numBands);
+
+  // Work through the features a block at a time, storing the exposure for each raster contiguously...
+  const std::size_t                        blockSize = 65536;
+  std::vector<oia::geometry::Vec2<double>> midPoints(blockSize);
+  std::vector<std::size_t>                 exposed(blockSize);
+  std::vector<float>                       values(blockSize*hazards.numBands);
+  for(std::size_t start=0; start<assets.features.size(); start+=blockSize){
+    std::size_t numFeatures = std::min(blockSize, assets.features.size() - start);
+
+    // Recover the mid-point of each feature in the block that could be exposed (the summary rules the rest out)...
+    std::size_t numExposed = 0;
+    for(std::size_t k=0; k<numFeatures; k++){
+      if(hazards.summary.anyHazard(assets.features.ll(start + k), assets.features.ur(start + k))){
+        exposed[numExposed]   = start + k;
+        midPoints[numExposed] = assets.features.mid_point(start + k);
+        numExposed++;
+      }
     }
 
-    // Write the buffered exposure data to disk (using the atrribute name)...
-    oia::utils::writeBuffer(buffer, rasterFile.second);
+    // ...sample every raster at once...
+    hazards.sample(midPoints.data(), numExposed, values.data());
 
-    // ...and stick it on the tab.
-    bufferFiles.push_back(rasterFile.second);
+    // ...and add the data to the buffer, a raster at a time.
+    for(int b=0; b<hazards.numBands; b++){
+      double* column = exposure.column(b);
+      for(std::size_t e=0; e<numExposed; e++)
+        column[exposed[e]] = values[e*hazards.numBands + b];
+    }
   }
 
 
   ////////////////////////////////////////////////////////////////
   // 4: Write the new MIF file with exposure attributes to disk...
-  assets.writefromBuffer(outputFile, bufferFiles);
+  assets.writefromBuffer(outputFile, exposure, hazards.names);
 
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <fstream>
+
+// Import the MapInfo header file, which takes care of other imports
+#include "oia_risk_model/mif.h"
+
+// Alias the imported namespace, to make it a little easier to use...
+namespace oia = oia_risk_model;
+
+/*
+ * This application is used to add length-weighted exposure statistics to (undivided) assets, for multiple sources, walking
+ * each asset across the hazard grid once rather than dividing it and sampling the pieces.
+ * Suggested compilation script: g++ asset_exposure_stats.cpp -std=c++17 -O3 -march=native -pthread -o asset_exposure_stats
+ */
+int main(int argc, char** argv){
+  /////////////////////////////////////////////////////////
+  // 0: Check that application has been called correctly...
+  if(argc != 4 && argc != 5)
+    // oia_risk_model exceptions are fairly blunt, and used this way...
+    oia::Exception("The asset_exposure_stats app needs to be called with three or four arguments:\n"
+                   "   1. Comma delimited steering file giving raster file name and attribute-name to store data against\n"
+                   "   2. Existing MIF file of linear assets (without extension)\n"
+                   "   3. Output file-name for the modified MapInfo (without exension)\n"
+                   "   4. (Optional) comma delimited list of hazard thresholds, e.g. 0.1,0.5,1\n\n"
+                   "The length of each asset in each cell is written to <output>_cell_lengths.csv (anything off the rasters is left out).\n"
+                   "NOTE: This application should ONLY be used for rasters with a common origin, cellsize and dimension.\n");
+
+  std::string rasterSteeringFile = std::string(argv[1]);
+  std::string mifFile            = std::string(argv[2]);
+  std::string outputFile         = std::string(argv[3]);
+
+  // Recover the thresholds (if any)...
+  std::vector<double> thresholds;
+  if(argc == 5){
+    std::vector<std::string_view> words;
+    oia::utils::splitLine(argv[4], ',', words);
+    for(auto word : words)
+      thresholds.push_back(oia::utils::parseNumber<double>(word));
+  }
+
+  // ...and that the nominated steering file exists...
+  if(!oia::utils::exists(rasterSteeringFile))
+    oia::Exception("The steering file of rasters does not exist");
+
+  //...as well as the MIF / MID.
+  oia::utils::mifExists(mifFile);
+
+
+  ////////////////////////////////////////////////////////////////////////////////////////////////
+  // 1: Read the steering file into a vector of key_value pairs (k=file_name, v=attribute_name)...
+  std::vector<std::pair<std::string,std::string>> rasterFiles = oia::readRasterSteeringFile(rasterSteeringFile);
+
+
+  ///////////////////////////////////////////////////////
+  // 2: Read the assets...
+  oia::MIF assets(mifFile);
+
+
+  ///////////////////////////////////////////////////////////////////
+  // 3: Add the exposure statistics for each raster in turn...
+  std::vector<oia::CellLength> cellLengths;
+  for(std::size_t i=0; i<rasterFiles.size(); i++){
+    // Read the raster (keeping a binary copy, so subsequent runs can map it rather than parse it)...
+    oia::Ascii ascii(rasterFiles.at(i).first, true);
+
+    // The rasters share a grid, so we only need to record the length in each cell once...
+    assets.addExposureStatistics(ascii, rasterFiles.at(i).second, thresholds, i == 0 ? &cellLengths : nullptr);
+  }
+
+
+  ////////////////////////////////////////////////////////////////
+  // 4: Write the new MIF file with exposure attributes to disk...
+  assets.write(outputFile);
+
+  // ...along with the length of each asset in each cell.
+  std::ofstream cellFile(outputFile + "_cell_lengths.csv");
+  cellFile << "feature,cell,length_km\n";
+  for(auto c : cellLengths)
+    cellFile << c.feature << "," << c.cell << "," << c.lengthKm << "\n";
+  cellFile.close();
+
+  return 0;
+}
@@ -12,7 +12,7 @@ namespace oia = oia_risk_model;
 
 /*
  * "Hello world" basic usage of oia_risk_model, which is a header-only library so only needs to be included (no linking).
- * Suggested compilation script: g++ hello_oia.cpp -std=c++17 -O3 -o hello_oia
+ * Suggested compilation script: g++ hello_oia.cpp -std=c++17 -O3 -pthread -o hello_oia
  */
 int main(int argc, char** argv){
   ////////////////////////////////////////////////////////////
@@ -49,7 +49,7 @@ int main(int argc, char** argv){
   assets.divideFeatures(flood_depth);
 
   // Add a new numerical attribute to the assets file...
-  assets.addAttribute("hello_oia", "Float");
+  int hello_column = assets.addAttribute("hello_oia", "Float");
 
   // Access some key features of the MIF file...
   std::cout << "After division, MIF file now has " << assets.features.size() << " features\n";
@@ -59,15 +59,15 @@ int main(int argc, char** argv){
 
   ///////////////////////////////////////////////////////////
   // 4. Calculate exposure for assets
-  for(auto& f : assets.features){
+  for(std::size_t i=0; i<assets.features.size(); i++){
     // Extract the mid_point from the feature...
-    oia::geometry::Vec2<double> mid_point = f.mid_point();
+    oia::geometry::Vec2<double> mid_point = assets.features.mid_point(i);
 
     // Find the depth associated with this point...
     double local_depth = flood_depth.data_at_point(mid_point);
 
     // Stick it on the tab...
-    f.attributes.push_back(std::to_string(local_depth));
+    assets.features.attributes[hello_column].setNumber(i, local_depth);
   }
 
 
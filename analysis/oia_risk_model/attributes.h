@@ -0,0 +1,425 @@
+#ifndef ATTRIBUTES_H
+#define ATTRIBUTES_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <charconv>
+
+#include "exceptions.h"
+#include "utils.h"
+#include "mapped_file.h"
+#include "parallel.h"
+
+namespace oia_risk_model{
+  // Types of attribute, taken from the Columns declaration of a MIF file...
+  enum AttributeType : std::int32_t {STRING, INTEGER, FLOAT};
+
+  // Value used to mark a missing Integer attribute (missing Float attributes are NaN, and missing strings are empty)...
+  const std::int64_t MISSING_INTEGER = std::numeric_limits<std::int64_t>::min();
+
+  // Helper function to recover the type of an attribute from its declaration in a MIF file (e.g. "  feature_length_km Float")...
+  inline AttributeType attributeType(const std::string& declaration){
+    std::vector<std::string_view> words;
+    utils::splitLine(declaration, ' ', words);
+    if(words.size() < 2)
+      return STRING;
+
+    // Decimal(w,d) is held as a Float, and SmallInt / LargeInt as an Integer...
+    std::string type = utils::lower_case(std::string(words.at(1)));
+    if(type.rfind("float", 0) == 0 || type.rfind("decimal", 0) == 0)
+      return FLOAT;
+    if(type.rfind("integer", 0) == 0 || type.rfind("smallint", 0) == 0 || type.rfind("largeint", 0) == 0)
+      return INTEGER;
+    return STRING;
+  }
+
+  // Helper function to declare a new attribute as it would appear in the Columns of a MIF file, given its name and type ("string",
+  // "float" or "integer")...
+  inline std::string attributeDeclaration(const std::string name, const std::string type, const int fieldSize=254){
+    std::string t = utils::lower_case(type);
+    if(t == "string")
+      return "  " + name + " Char(" + std::to_string(fieldSize) + ")";
+    if(t == "float")
+      return "  " + name + " Float";
+    if(t == "integer")
+      return "  " + name + " Integer";
+
+    Exception("Unknown attribute type (" + type + ")");
+    return "";
+  }
+
+  // The distinct values of a string column, and the code of each...
+  struct StringDictionary{
+    std::vector<std::string>                       values;  // Distinct values (code 0 is the empty string)
+    std::unordered_map<std::string, std::uint32_t> lookup;  // Code of each value
+  };
+
+  // A single column of attributes. Numbers are held as numbers, while strings are dictionary-encoded: each distinct value is
+  // held once (verbatim, quotes and all, as it appears in the MID) and each row holds the code of its value. A deferred column
+  // holds no values at all, as they are being left on disk until needed (see MIF::justInTime)...
+  //   NOTE: Copies of a column (e.g. slices, or a table's schema) share its dictionary, which is only copied if one of them
+  //         adds a value to it, so copying rows of a column never copies its strings.
+  struct AttributeColumn{
+    AttributeType                     type;        // Type of the attribute
+    bool                              deferred;    // Are the values being left on disk?
+    std::vector<double>               floats;      // Values of a Float column
+    std::vector<std::int64_t>         integers;    // Values of an Integer column
+    std::vector<std::uint32_t>        codes;       // Dictionary code of each value of a string column
+    std::shared_ptr<StringDictionary> dictionary;  // Distinct values of a string column (shared with any copies of the column)
+
+    AttributeColumn(const AttributeType type=STRING, const bool deferred=false) : type(type), deferred(deferred){
+      if(type == STRING)
+        clearDictionary();
+    }
+
+    // Helper method to empty the dictionary of a string column (leaving the empty string, as code 0)...
+    void clearDictionary(void){
+      dictionary = std::make_shared<StringDictionary>();
+      encode("");
+    }
+
+    // Resize the column, filling any new rows with missing values...
+    void resize(const std::size_t n){
+      if(deferred)
+        return;
+      if(type == FLOAT)
+        floats.resize(n, std::numeric_limits<double>::quiet_NaN());
+      else if(type == INTEGER)
+        integers.resize(n, MISSING_INTEGER);
+      else
+        codes.resize(n, 0);
+    }
+
+    // Make room for n rows, without filling them...
+    void reserve(const std::size_t n){
+      if(deferred)
+        return;
+      if(type == FLOAT)
+        floats.reserve(n);
+      else if(type == INTEGER)
+        integers.reserve(n);
+      else
+        codes.reserve(n);
+    }
+
+    // Hand the memory holding rows [begin, end) back to the kernel, once they are no longer needed (see utils::releasePages)...
+    void release(const std::size_t begin, const std::size_t end){
+      if(deferred || begin >= end)
+        return;
+      if(type == FLOAT)
+        utils::releasePages(floats.data() + begin, floats.data() + end);
+      else if(type == INTEGER)
+        utils::releasePages(integers.data() + begin, integers.data() + end);
+      else
+        utils::releasePages(codes.data() + begin, codes.data() + end);
+    }
+
+    // Helper method to find (or add) the code of a string in the dictionary (NOTE: not thread-safe)...
+    std::uint32_t encode(const std::string_view value){
+      std::string key(value);
+      auto it = dictionary->lookup.find(key);
+      if(it != dictionary->lookup.end())
+        return it->second;
+
+      // A dictionary shared with another column needs copying before it can be changed...
+      if(dictionary.use_count() > 1)
+        dictionary = std::make_shared<StringDictionary>(*dictionary);
+      std::uint32_t code = dictionary->values.size();
+      dictionary->lookup.emplace(key, code);
+      dictionary->values.push_back(std::move(key));
+      return code;
+    }
+
+    // Helper methods to parse numbers, where an empty value is missing. Anything else that isn't wholly a number of the right type
+    // (e.g. "NULL", "N/A", or "3.7" in an Integer column) is missing too, and clears ok (if given) so the caller can warn about it...
+    static double parseFloat(const std::string_view value, bool* ok=nullptr){
+      double v = std::numeric_limits<double>::quiet_NaN();
+      if(!utils::tryParseNumber(value, v) && ok && value.find_first_not_of(" \t\r") != std::string_view::npos)
+        *ok = false;
+      return v;
+    }
+
+    static std::int64_t parseInteger(const std::string_view value, bool* ok=nullptr){
+      std::int64_t v = MISSING_INTEGER;
+      if(!utils::tryParseNumber(value, v) && ok && value.find_first_not_of(" \t\r") != std::string_view::npos)
+        *ok = false;
+      return v;
+    }
+
+    // Helper method to get the value of a numeric attribute (missing values are NaN)...
+    double number(const std::size_t row) const {
+      if(type == FLOAT)
+        return floats[row];
+      if(type == INTEGER)
+        return integers[row] == MISSING_INTEGER ? std::numeric_limits<double>::quiet_NaN() : double(integers[row]);
+
+      Exception("Attempt to read a string attribute as a number");
+      return 0;
+    }
+
+    // Helper method to set the value of a numeric attribute...
+    void setNumber(const std::size_t row, const double value){
+      if(type == FLOAT)
+        floats[row] = value;
+      else if(type == INTEGER)
+        integers[row] = std::isnan(value) ? MISSING_INTEGER : std::int64_t(std::llround(value));
+      else
+        Exception("Attempt to set a string attribute to a number");
+    }
+
+    // Helper method to get the value of a string attribute...
+    const std::string& string(const std::size_t row) const {
+      if(type != STRING)
+        Exception("Attempt to read a numeric attribute as a string");
+      return dictionary->values[codes[row]];
+    }
+
+    // Helper method to set an attribute from its text (as it would appear in the MID)...
+    void set(const std::size_t row, const std::string_view value){
+      if(type == FLOAT)
+        floats[row] = parseFloat(value);
+      else if(type == INTEGER)
+        integers[row] = parseInteger(value);
+      else
+        codes[row] = encode(value);
+    }
+
+    // Helper method to compare the attributes of two rows...
+    bool equal(const std::size_t a, const std::size_t b) const {
+      if(type == FLOAT)
+        return floats[a] == floats[b] || (std::isnan(floats[a]) && std::isnan(floats[b]));
+      if(type == INTEGER)
+        return integers[a] == integers[b];
+      return codes[a] == codes[b];
+    }
+
+    // Helper method to append the text of an attribute to a string (numbers are written in the shortest form that reads
+    // back as the same value, and missing numbers are left empty)...
+    void format(const std::size_t row, std::string& out) const {
+      char buffer[32];
+      std::to_chars_result result{buffer, std::errc()};
+      if(type == FLOAT){
+        formatFloat(floats[row], out);
+        return;
+      }else if(type == INTEGER){
+        if(integers[row] != MISSING_INTEGER)
+          result = std::to_chars(buffer, buffer + sizeof(buffer), integers[row]);
+      }else{
+        out += dictionary->values[codes[row]];
+        return;
+      }
+      out.append(buffer, result.ptr);
+    }
+
+    // ...which for a Float is done by this (so values that never make it into a column can be written the same way).
+    static void formatFloat(const double value, std::string& out){
+      if(std::isnan(value))
+        return;
+      char buffer[32];
+      out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+    }
+
+    // Helper method to get the text of an attribute...
+    std::string text(const std::size_t row) const {
+      std::string s;
+      format(row, s);
+      return s;
+    }
+
+    // Helper method to copy rows [begin, end) of the column (sharing its dictionary)...
+    AttributeColumn slice(const std::size_t begin, const std::size_t end) const {
+      AttributeColumn c(type);
+      if(type == FLOAT){
+        c.floats.assign(floats.begin() + begin, floats.begin() + end);
+      }else if(type == INTEGER){
+        c.integers.assign(integers.begin() + begin, integers.begin() + end);
+      }else{
+        c.dictionary = dictionary;
+        c.codes.assign(codes.begin() + begin, codes.begin() + end);
+      }
+      return c;
+    }
+  };
+
+  // Table of typed attributes, with a column per attribute and a row per feature...
+  struct AttributeTable{
+    std::vector<AttributeColumn> columns;    // Columns of the table
+    std::size_t                  numRows=0;  // Number of rows in the table
+
+    std::size_t size(void) const { return numRows; }
+    std::size_t numColumns(void) const { return columns.size(); }
+    AttributeColumn& operator[](const std::size_t c) { return columns[c]; }
+    const AttributeColumn& operator[](const std::size_t c) const { return columns[c]; }
+
+    // Add a column to the table (filled with missing values, unless its values are being left on disk)...
+    void addColumn(const AttributeType type, const bool deferred=false){
+      columns.emplace_back(type, deferred);
+      columns.back().resize(numRows);
+    }
+
+    // Resize the table, filling any new rows with missing values...
+    void resize(const std::size_t n){
+      numRows = n;
+      for(auto& c : columns)
+        c.resize(n);
+    }
+
+    // Make room for n rows in every column...
+    void reserve(const std::size_t n){
+      for(auto& c : columns)
+        c.reserve(n);
+    }
+
+    // Hand the memory holding rows [begin, end) back to the kernel, once they are no longer needed...
+    void release(const std::size_t begin, const std::size_t end){
+      for(auto& c : columns)
+        c.release(begin, end);
+    }
+
+    // Remove every row (keeping the columns and their dictionaries)...
+    void clear(void){
+      resize(0);
+    }
+
+    // A copy of the table's columns (sharing their dictionaries), without any rows (ready for copyRow)...
+    AttributeTable schema(void) const {
+      AttributeTable t;
+      for(const auto& c : columns){
+        t.columns.emplace_back(c.type, c.deferred);
+        t.columns.back().dictionary = c.dictionary;
+      }
+      return t;
+    }
+
+    // Copy a row from a table with the same schema (NOTE: string codes are copied as they are, so the tables must share their
+    // dictionaries, e.g. by one being made from the other's schema)...
+    void copyRow(const AttributeTable& from, const std::size_t fromRow, const std::size_t toRow){
+      for(std::size_t c=0; c<columns.size(); c++){
+        if(columns[c].deferred)
+          continue;
+        if(columns[c].type == FLOAT)
+          columns[c].floats[toRow] = from.columns[c].floats[fromRow];
+        else if(columns[c].type == INTEGER)
+          columns[c].integers[toRow] = from.columns[c].integers[fromRow];
+        else
+          columns[c].codes[toRow] = from.columns[c].codes[fromRow];
+      }
+    }
+
+    // Helper method to append a row of the table to a string as delimited text (skipping any dropped columns)...
+    void formatRow(const std::size_t row, std::string& out, const std::vector<bool>* dropColumn=nullptr, const char delim=',') const {
+      bool first = true;
+      for(std::size_t c=0; c<columns.size(); c++){
+        if(dropColumn && dropColumn->at(c))
+          continue;
+        if(!first)
+          out += delim;
+        columns[c].format(row, out);
+        first = false;
+      }
+    }
+
+    // Helper method to recover a row as a vector of strings...
+    std::vector<std::string> strings(const std::size_t row) const {
+      std::vector<std::string> words(columns.size());
+      for(std::size_t c=0; c<columns.size(); c++)
+        columns[c].format(row, words[c]);
+      return words;
+    }
+
+    // Parse lines of delimited text (e.g. from a MID file) into the table in parallel (threads = 0 means use all cores). Line k
+    // fills rows firstRow[k] to firstRow[k+1]-1, as a MIF region shares one line of the MID between its polygons. Each thread
+    // builds its own dictionaries, which are then merged in line order so the codes don't depend on the number of threads...
+    void parse(const std::vector<std::string_view>& lines, const std::vector<std::size_t>& firstRow, const int threads=0,
+               const char delim=','){
+      resize(firstRow.back());
+
+      // Each thread's dictionaries (local codes are positions in values), and the numbers it couldn't read...
+      struct Dictionaries{
+        std::vector<std::unordered_map<std::string_view, std::uint32_t>> lookup;
+        std::vector<std::vector<std::string_view>>                       values;
+        std::vector<std::size_t>                                         unread;
+        std::vector<std::string_view>                                    example;
+      };
+      std::vector<Dictionaries> local(parallel::numThreads(threads));
+
+      parallel::forChunks(lines.size(), local.size(), [&](std::size_t t, std::size_t begin, std::size_t end){
+        local[t].lookup.resize(columns.size());
+        local[t].values.resize(columns.size());
+        local[t].unread.resize(columns.size(), 0);
+        local[t].example.resize(columns.size());
+
+        std::vector<std::string_view> fields;
+        for(std::size_t k=begin; k<end; k++){
+          utils::splitFields(lines[k], delim, fields);
+
+          // Tolerate empty fields past the last column (older MIDs were written with a trailing delimiter)...
+          while(fields.size() > columns.size() && fields.back().find_first_not_of(" \t") == std::string_view::npos)
+            fields.pop_back();
+          if(fields.size() > columns.size())
+            Exception("Attribute row has more values than there are columns (" + std::string(lines[k]) + ")");
+
+          for(std::size_t c=0; c<columns.size(); c++){
+            std::string_view value = c < fields.size() ? fields[c] : std::string_view();
+            AttributeColumn& column = columns[c];
+
+            // Parse the value once, then copy it to every row sharing the line...
+            bool ok = true;
+            if(column.type == FLOAT){
+              double v = AttributeColumn::parseFloat(value, &ok);
+              std::fill(column.floats.begin() + firstRow[k], column.floats.begin() + firstRow[k+1], v);
+            }else if(column.type == INTEGER){
+              std::int64_t v = AttributeColumn::parseInteger(value, &ok);
+              std::fill(column.integers.begin() + firstRow[k], column.integers.begin() + firstRow[k+1], v);
+            }else{
+              auto it = local[t].lookup[c].emplace(value, local[t].values[c].size());
+              if(it.second)
+                local[t].values[c].push_back(value);
+              std::fill(column.codes.begin() + firstRow[k], column.codes.begin() + firstRow[k+1], it.first->second);
+            }
+            if(!ok && local[t].unread[c]++ == 0)
+              local[t].example[c] = value;
+          }
+        }
+      });
+
+      // Let the user know about any numbers that couldn't be read (and have been taken as missing)...
+      for(std::size_t c=0; c<columns.size(); c++){
+        std::size_t      unread = 0;
+        std::string_view example;
+        for(const auto& l : local){
+          if(c < l.unread.size() && l.unread[c] > 0 && unread == 0)
+            example = l.example[c];
+          unread += c < l.unread.size() ? l.unread[c] : 0;
+        }
+        if(unread > 0)
+          std::cout << "WARNING: " << unread << " value(s) of attribute " << c + 1 << " can't be read as its type of number (e.g. "
+                    << example << "), so are taken as missing\n";
+      }
+
+      // Merge the dictionaries, working out what each thread's codes become...
+      std::vector<std::vector<std::vector<std::uint32_t>>> remap(local.size(), std::vector<std::vector<std::uint32_t>>(columns.size()));
+      for(std::size_t t=0; t<local.size(); t++)
+        for(std::size_t c=0; c<columns.size(); c++)
+          if(columns[c].type == STRING && c < local[t].values.size())
+            for(auto value : local[t].values[c])
+              remap[t][c].push_back(columns[c].encode(value));
+
+      // ...and recode the rows (the chunks match those used to parse the lines).
+      parallel::forChunks(lines.size(), local.size(), [&](std::size_t t, std::size_t begin, std::size_t end){
+        for(std::size_t c=0; c<columns.size(); c++)
+          if(columns[c].type == STRING)
+            for(std::size_t row=firstRow[begin]; row<firstRow[end]; row++)
+              columns[c].codes[row] = remap[t][c][columns[c].codes[row]];
+      });
+    }
+  };
+} // oia_risk_model
+
+#endif //ATTRIBUTES_H
@@ -0,0 +1,154 @@
+#ifndef CELL_RISK_H
+#define CELL_RISK_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "exceptions.h"
+#include "geom.h"
+#include "raster.h"
+#include "raster_stack.h"
+#include "fragility.h"
+#include "graph.h"
+#include "parallel.h"
+#include "utils.h"
+
+namespace oia_risk_model{
+  // Structure holding the annual probability of failure of an asset in each cell of a hazard grid, for each condition grade (CG)
+  // of a fragility curve. Fragility only depends on the CG and the hazard, so given a stack of rasters holding the hazard at each
+  // return period (RP) of a scenario, the area under the curve of pFail against annual probability (1/RP) can be worked out once
+  // for each cell, rather than once for each asset in it. Assets then read their annual probability of failure with a lookup...
+  struct CellRisk{
+    int                 ncols;     // number of columns in the grid
+    int                 nrows;     // number of rows in the grid
+    double              xll;       // xl corner of the grid
+    double              yll;       // yll corner of the grid
+    double              cellsize;  // x, y cell dimension of the grid
+    std::size_t         numCells;  // For convenience, store the number of cells (calculated, as for Ascii)
+    int                 numCG;     // Number of CGs in the fragility curve
+    std::vector<float>  annual;    // Annual probability of failure, cell-by-cell with the CGs of each cell held together
+    std::vector<double> outside;   // Annual probability of failure of each CG outside the grid (i.e. with no hazard at any RP)
+
+    // Helper function to recover the RP from the name of a band, following the columns read by RoadFragility (e.g. the RP of
+    // "flood_2050_RP100" is 100)...
+    static int returnPeriod(const std::string& name){
+      std::vector<std::string_view> words;
+      utils::splitLine(name, '_', words);
+      if(words.empty() || words.back().size() < 3 || words.back().substr(0, 2) != "RP")
+        Exception("Unable to find the return period of " + name);
+      return utils::parseNumber<int>(words.back().substr(2));
+    }
+
+    // Work out the annual probability of failure in every cell of a stack of rasters, giving the hazard at each RP of a single
+    // scenario (the RP of each band is taken from its name, unless they are given)...
+    //   threads: number of threads used to work through the cells (0 means use all cores).
+    CellRisk(const RasterStack& hazards, const fragility::FragilityCurve& f, std::vector<int> returnPeriods={}, const int threads=0)
+      : ncols(hazards.ncols), nrows(hazards.nrows), xll(hazards.xll), yll(hazards.yll), cellsize(hazards.cellsize),
+        numCells(hazards.numCells), numCG(f.numCG){
+      const int numBands = hazards.numBands;
+      if(returnPeriods.empty())
+        for(const auto& name : hazards.names)
+          returnPeriods.push_back(returnPeriod(name));
+      if(int(returnPeriods.size()) != numBands)
+        Exception("Every raster in the stack needs a return period");
+
+      // Lay out the curve: the last band first (as for RoadFragility), running from the longest RP to the shortest...
+      std::vector<int> order;
+      for(int b=numBands-1; b>=0; b--)
+        order.push_back(b);
+      std::stable_sort(order.begin(), order.end(), [&](int a, int b){ return returnPeriods[a] > returnPeriods[b]; });
+      std::vector<double> X;
+      for(auto b : order)
+        X.push_back(1.0/double(returnPeriods[b]));
+
+      // Work through the cells a block at a time, interpolating the fragility of each band for a CG, then integrating...
+      annual.resize(numCells*numCG);
+      auto integrate = [&](const float* cells, const std::size_t m, float* out, std::vector<double>& loads, std::vector<double>& pFail,
+                           std::vector<const double*>& points){
+        loads.resize(numBands*m);
+        pFail.resize((numBands + 1)*m);
+        points.resize(numBands);
+        double* area = &pFail[numBands*m];
+
+        // Take a copy of the hazard in each band (contiguous, so the fragility can be calculated a band at a time)...
+        for(std::size_t k=0; k<m; k++)
+          for(int b=0; b<numBands; b++)
+            loads[b*m + k] = cells[k*numBands + b];
+
+        for(int CG=1; CG<=numCG; CG++){
+          for(int b=0; b<numBands; b++)
+            f.probabilities(CG, &loads[b*m], m, &pFail[b*m]);
+
+          // Integrate under the curve of every cell in the block...
+          for(std::size_t p=0; p<order.size(); p++)
+            points[p] = &pFail[order[p]*m];
+          fragility::areas(X.data(), points.data(), order.size(), m, area);
+
+          for(std::size_t k=0; k<m; k++)
+            out[k*numCG + CG - 1] = float(area[k]);
+        }
+      };
+
+      parallel::forChunks(numCells, threads, [&](std::size_t, std::size_t begin, std::size_t end){
+        std::vector<double>        loads, pFail;
+        std::vector<const double*> points;
+        for(std::size_t start=begin; start<end; start+=SAMPLE_BLOCK){
+          const std::size_t m = std::min(SAMPLE_BLOCK, end - start);
+          integrate(hazards.values(start), m, &annual[start*numCG], loads, pFail, points);
+        }
+      });
+
+      // Anything outside the grid sees no hazard at all...
+      std::vector<float>         none(numBands, 0.0f), noneRisk(numCG);
+      std::vector<double>        loads, pFail;
+      std::vector<const double*> points;
+      integrate(none.data(), 1, noneRisk.data(), loads, pFail, points);
+      outside.assign(noneRisk.begin(), noneRisk.end());
+    }
+
+    // Helper method to find the cell a point falls in, by column and row (or -1 if the point is outside the grid)...
+    int cellAt(const geometry::Vec2<double> p) const {
+      return gridCellIndex(p, xll, yll, cellsize, ncols, nrows);
+    }
+
+    // Helper method to return the annual probability of failure of an asset of a given CG at a point (0 if the CG is not covered
+    // by the fragility curve, as for FragilityCurve::probability)...
+    double annualProbability(const geometry::Vec2<double> p, const int CG) const {
+      if(CG < 1 || CG > numCG)
+        return 0;
+
+      // Guard on cell being out-of-range...
+      int cI = cellAt(p);
+      if(cI < 0)
+        return outside[CG-1];
+
+      return annual[std::size_t(cI)*numCG + CG - 1];
+    }
+
+    // Helper method to look up the annual probability of failure at a contiguous array of points, each with its own CG (NOTE:
+    // as for annualProbability, points are placed in the grid by column and row, so anything off the sides is outside)...
+    void annualProbabilities(const geometry::Vec2<double>* points, const int* CG, const std::size_t n, double* out) const {
+      int indices[SAMPLE_BLOCK];
+      for(std::size_t start=0; start<n; start+=SAMPLE_BLOCK){
+        std::size_t m = std::min(SAMPLE_BLOCK, n - start);
+
+        // Calculate the cell indices for a block of points...
+        batchCellIndex(points + start, m, indices, xll, yll, cellsize, ncols, nrows);
+
+        // ...and look up each.
+        for(std::size_t k=0; k<m; k++){
+          const int cg = CG[start + k];
+          if(cg < 1 || cg > numCG)
+            out[start + k] = 0;
+          else if(indices[k] < 0)
+            out[start + k] = outside[cg-1];
+          else
+            out[start + k] = annual[std::size_t(indices[k])*numCG + cg - 1];
+        }
+      }
+    }
+  };
+} // oia_risk_model
+
+#endif //CELL_RISK_H
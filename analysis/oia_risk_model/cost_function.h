@@ -56,7 +56,8 @@ namespace oia_risk_model{
       inFile.open(fileName);
 
       // Space for the incoming data...
-      std::string line;
+      std::string                   line;
+      std::vector<std::string_view> words;
 
       // Somewhere to store the resulting costfunction...
       CostFunction cf;
@@ -68,14 +69,14 @@ namespace oia_risk_model{
         // If it's valid....
         if(line.size() > 0){
           // Chunk it into words...
-          std::vector<std::string> words = utils::readLine(line);
+          utils::splitLine(line, ',', words);
           // If it fits the desired pattern, parse it further...
           if(words.size() == 3){
             if(words.at(0) == "\"default\""){
-              cf.default_min = std::stod(words.at(1));
-              cf.default_max = std::stod(words.at(2));
+              cf.default_min = utils::parseNumber<double>(words.at(1));
+              cf.default_max = utils::parseNumber<double>(words.at(2));
             }else{
-              Cost c(words.at(0), std::stod(words.at(1)), std::stod(words.at(2)));
+              Cost c(std::string(words.at(0)), utils::parseNumber<double>(words.at(1)), utils::parseNumber<double>(words.at(2)));
               cf.costs.push_back(c);
             }
           }
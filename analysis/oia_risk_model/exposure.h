@@ -0,0 +1,91 @@
+#ifndef EXPOSURE_H
+#define EXPOSURE_H
+
+#include <vector>
+
+#include "geom.h"
+#include "raster.h"
+
+namespace oia_risk_model{
+  // Structure holding the exposure of a single feature to a raster, accumulated while walking the feature across the grid...
+  struct ExposureStatistics{
+    double              lengthKm  = 0;  // Haversine length of the feature (km)
+    double              maxDepth  = 0;  // Maximum hazard value along the feature
+    double              meanDepth = 0;  // Length-weighted mean hazard value along the feature
+    std::vector<double> lengthAbove;    // Length of the feature (km) exposed to a hazard value above each threshold
+  };
+
+  // Structure holding the length of a feature that falls in a single cell of a raster...
+  struct CellLength{
+    std::size_t feature;   // Index of the feature
+    int         cell;      // Hashed index of the cell in the raster
+    double      lengthKm;  // Haversine length of the feature in the cell (km)
+  };
+
+  // Helper function to calculate the exposure of a feature to a raster in a single pass over the grid, optionally recording
+  // the length of the feature in each cell it passes through (consecutive pieces in the same cell are combined). Anything
+  // outside the raster sees no hazard, and isn't recorded against a cell...
+  inline ExposureStatistics exposureStatistics(const Ascii& ascii, const geometry::Vec2<double>* points, const std::size_t numPoints,
+                                               const std::vector<double>& thresholds, const std::size_t featureIndex=0,
+                                               std::vector<CellLength>* cellLengths=nullptr){
+    ExposureStatistics stats;
+    stats.lengthAbove.assign(thresholds.size(), 0);
+    if(numPoints == 0)
+      return stats;
+
+    // If the summary shows the feature can't be exposed, all that is left to do is measure it...
+    geometry::Vec2<double> ll = points[0], ur = points[0];
+    for(std::size_t i=1; i<numPoints; i++){
+      ll.x = std::min(ll.x, points[i].x); ll.y = std::min(ll.y, points[i].y);
+      ur.x = std::max(ur.x, points[i].x); ur.y = std::max(ur.y, points[i].y);
+    }
+    bool exposed = ascii.summary.anyHazard(ll, ur);
+
+    // Loop over each line in the feature...
+    double weighted = 0;
+    for(std::size_t i=0; i+1<numPoints; i++){
+      geometry::Line2<double> line(points[i], points[i+1]);
+
+      // Without a hazard, or a record of the cells to keep, the length of the line is all we need...
+      if(!exposed && !cellLengths){
+        stats.lengthKm += geometry::haversine(line);
+        continue;
+      }
+
+      // ...otherwise, walk the line across the grid.
+      ascii.traverse(line, [&](int cI, const geometry::Vec2<double>& entry, const geometry::Vec2<double>& exit, double){
+        double km = geometry::haversine(geometry::Line2<double>(entry, exit));
+
+        // Pieces that only touch the corner of a cell aren't exposed to it...
+        if(km <= 0)
+          return;
+
+        double value = (!exposed || cI < 0) ? 0 : ascii.value(cI);
+
+        // Accumulate the statistics...
+        stats.lengthKm += km;
+        stats.maxDepth  = std::max(stats.maxDepth, value);
+        weighted       += km*value;
+        for(std::size_t t=0; t<thresholds.size(); t++)
+          if(value > thresholds[t])
+            stats.lengthAbove[t] += km;
+
+        // ...and the length of the feature in the cell.
+        if(cellLengths && cI >= 0){
+          if(!cellLengths->empty() && cellLengths->back().feature == featureIndex && cellLengths->back().cell == cI)
+            cellLengths->back().lengthKm += km;
+          else
+            cellLengths->push_back(CellLength{featureIndex, cI, km});
+        }
+      });
+    }
+
+    // Finally, turn the weighted sum into a mean...
+    if(stats.lengthKm > 0)
+      stats.meanDepth = weighted / stats.lengthKm;
+
+    return stats;
+  }
+} // oia_risk_model
+
+#endif //EXPOSURE_H
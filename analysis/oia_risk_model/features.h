@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "geom.h"
+#include "attributes.h"
 
 namespace oia_risk_model{
   // Basic feature structure...
@@ -91,6 +92,126 @@ namespace oia_risk_model{
       pOut = ll - geometry::Vec2<double>(0.0001,0.0001);
     }
   };
+
+  // Flat, structure-of-arrays store of many features: the points of every feature share one coordinate buffer (feature i owns
+  // points offsets[i] to offsets[i+1]-1), with the bounding boxes held in their own arrays...
+  struct FeatureStore{
+    std::vector<geometry::Vec2<double>>   coords;      // Points of every feature, one feature after another
+    std::vector<std::size_t>              offsets{0};  // Index of the first point of each feature (plus one past the last point)
+    std::vector<double>                   llx;         // Lower-left x of each feature's bounding-box (calculated)
+    std::vector<double>                   lly;         // Lower-left y of each feature's bounding-box (calculated)
+    std::vector<double>                   urx;         // Upper-right x of each feature's bounding-box (calculated)
+    std::vector<double>                   ury;         // Upper-right y of each feature's bounding-box (calculated)
+    AttributeTable                        attributes;  // Typed attributes of the features (a row per feature)
+
+    // Helper methods to access the features...
+    std::size_t size(void) const { return offsets.size() - 1; }
+    bool empty(void) const { return size() == 0; }
+    std::size_t numPoints(const std::size_t i) const { return offsets[i+1] - offsets[i]; }
+    const geometry::Vec2<double>* points(const std::size_t i) const { return coords.data() + offsets[i]; }
+    geometry::Vec2<double>* points(const std::size_t i) { return coords.data() + offsets[i]; }
+    const geometry::Vec2<double>& first(const std::size_t i) const { return coords[offsets[i]]; }
+    const geometry::Vec2<double>& last(const std::size_t i) const { return coords[offsets[i+1] - 1]; }
+    geometry::Vec2<double> ll(const std::size_t i) const { return geometry::Vec2<double>(llx[i], lly[i]); }
+    geometry::Vec2<double> ur(const std::size_t i) const { return geometry::Vec2<double>(urx[i], ury[i]); }
+
+    // Helper method to get the geometric mid-point of a feature from its bounding box...
+    geometry::Vec2<double> mid_point(const std::size_t i) const {
+      return geometry::Vec2<double>((llx[i] + urx[i])/2,(lly[i] + ury[i])/2);
+    }
+
+    // Helper function to calculate the BB of a feature from its points...
+    void addBB(const std::size_t i){
+      // Give the ll and ur points a starting point...
+      geometry::Vec2<double> l = first(i), u = first(i);
+
+      // Identify the min and max x, y values of the geometry...
+      for(std::size_t p=offsets[i]; p<offsets[i+1]; p++){
+        l.x = std::min(coords[p].x, l.x);
+        u.x = std::max(coords[p].x, u.x);
+        l.y = std::min(coords[p].y, l.y);
+        u.y = std::max(coords[p].y, u.y);
+      }
+
+      llx[i] = l.x; lly[i] = l.y;
+      urx[i] = u.x; ury[i] = u.y;
+    }
+
+    // Helper function to calculate the BB of every feature...
+    void addBB(void){
+      for(std::size_t i=0; i<size(); i++)
+        addBB(i);
+    }
+
+    // Resize the store to hold numFeatures features and numPoints points (offsets need filling in by the caller)...
+    void resize(const std::size_t numFeatures, const std::size_t numPoints){
+      coords.resize(numPoints);
+      offsets.resize(numFeatures + 1);
+      llx.resize(numFeatures); lly.resize(numFeatures);
+      urx.resize(numFeatures); ury.resize(numFeatures);
+      attributes.resize(numFeatures);
+    }
+
+    // Make room for more features and points...
+    void reserve(const std::size_t numFeatures, const std::size_t numPoints){
+      coords.reserve(numPoints);
+      offsets.reserve(numFeatures + 1);
+      llx.reserve(numFeatures); lly.reserve(numFeatures);
+      urx.reserve(numFeatures); ury.reserve(numFeatures);
+      attributes.reserve(numFeatures);
+    }
+
+    // Hand the memory holding features [begin, end) back to the kernel, once they are no longer needed (e.g. as a store is
+    // consumed a range at a time). The features stay in the store, but their points, BBs and attributes read as zeros...
+    void release(const std::size_t begin, const std::size_t end){
+      if(begin >= end)
+        return;
+      utils::releasePages(coords.data() + offsets[begin], coords.data() + offsets[end]);
+      utils::releasePages(offsets.data() + begin, offsets.data() + end);
+      utils::releasePages(llx.data() + begin, llx.data() + end);
+      utils::releasePages(lly.data() + begin, lly.data() + end);
+      utils::releasePages(urx.data() + begin, urx.data() + end);
+      utils::releasePages(ury.data() + begin, ury.data() + end);
+      attributes.release(begin, end);
+    }
+
+    // Add a feature made from a run of points, with missing attributes (its BB is calculated as it goes in)...
+    void append(const geometry::Vec2<double>* pts, const std::size_t n){
+      coords.insert(coords.end(), pts, pts + n);
+      offsets.push_back(coords.size());
+      llx.push_back(0); lly.push_back(0);
+      urx.push_back(0); ury.push_back(0);
+      attributes.resize(size());
+      if(n > 0)
+        addBB(size() - 1);
+    }
+
+    // Add a copy of a Feature (its attributes are parsed into the columns of the store)...
+    void append(const Feature& f){
+      append(f.geometry.data(), f.geometry.size());
+      for(std::size_t c=0; c<f.attributes.size() && c<attributes.numColumns(); c++)
+        attributes[c].set(size() - 1, f.attributes[c]);
+    }
+
+    // Recover a feature as a stand-alone Feature...
+    Feature feature(const std::size_t i) const {
+      Feature f;
+      f.geometry.assign(points(i), points(i) + numPoints(i));
+      f.attributes = attributes.strings(i);
+      f.ll = ll(i);
+      f.ur = ur(i);
+      return f;
+    }
+
+    // Remove every feature...
+    void clear(void){
+      coords.clear();
+      offsets.assign(1, 0);
+      llx.clear(); lly.clear();
+      urx.clear(); ury.clear();
+      attributes.clear();
+    }
+  };
 } // oia_risk_model
 
 #endif //FEATURES_H
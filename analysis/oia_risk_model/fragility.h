@@ -23,29 +23,32 @@ namespace oia_risk_model{
       double                  minLoad;                // Minimum load (calculated)
       double                  maxLoad;                // Maximum load (calculated)
       double                  deltaLoad;              // Load delta (calculated)
+      std::vector<double>     gap;                    // Gap between each pair of neighbouring loads (calculated)
+      std::vector<double>     curves;                 // pFail laid out a CG at a time, numLoads values for each (calculated)
       // Constructor - curve will be read from a nominated file, user to specify if this curve represents structural failure or not...
       FragilityCurve(const std::string fileName, const bool structuralFailue = true){
         // Open the incoming file...
-        if(utils::exists(fileName)){
+        if(!utils::exists(fileName)){
           Exception("The Fragility curve file-name does not exist.");
           return;
         }
         std::ifstream inFile;
         inFile.open(fileName);
         std::string line;
+        std::vector<std::string_view> words;
 
         // Loop over the complete file
         while(!inFile.eof()){
           std::getline(inFile, line);
-          std::vector<std::string> words = utils::readLine(line);
+          utils::splitLine(line, ',', words);
           // Get size of the incoming data...
           int numFields = words.size();
           if(numFields > 0){
             // Recover the load...
-            load.push_back(std::stod(words.at(0)));
+            load.push_back(utils::parseNumber<double>(words.at(0)));
             // Recover the pFail data...
             for(int i=1; i<numFields; i++){
-              pFail.push_back(std::stod(words.at(i)));
+              pFail.push_back(utils::parseNumber<double>(words.at(i)));
             }
           }
         }
@@ -57,6 +60,13 @@ namespace oia_risk_model{
         maxLoad = load.at(load.size()-1);
         deltaLoad = load.at(1) - load.at(0);
 
+        // Lay out the tables used to interpolate the curve (see probabilities)...
+        for(int i=0; i<numLoads-1; i++)
+          gap.push_back(load.at(i+1) - load.at(i));
+        for(int CG=1; CG<=numCG; CG++)
+          for(int i=0; i<numLoads; i++)
+            curves.push_back(pFail.at(i*numCG + (CG-1)));
+
         // Close the incoming file...
         inFile.close();
 
@@ -107,32 +117,65 @@ namespace oia_risk_model{
         return 4;
       }
 
-      // Get the fragility associated with an asset at a given load (using linear interpolation)
-      double probability(const int CG, const double l) const {
-        // Firstly, is this load too small to trouble the scorers?
-        if(l <= minLoad)
-          return pFail.at(0);
-
-        // Make sure the CG is in range (else return something that won't break the callers code)...
-        if(CG < 1 ||  CG > numCG)
-          return 0;
-
-        // All good, so get the index of the load...
-        int index = std::floor((l - minLoad) / deltaLoad);
-
-        // Make sure the load isn't greater than the range of load data...
-        if(l >= load.at(load.size()-1))
-          return pFail.at((numLoads-1)*numCG + (CG -1));
+      // Helper method to interpolate the curve at a run of loads, with CG(i) giving the CG for load i. The loop is written without
+      // branches (every case is worked out, then the right one picked) over the tables laid out by the constructor, so that it
+      // can be vectorised (NOTE: the table lookups need gathers, so this only happens when AVX2 is enabled, as the Makefile does).
+      // It divides where the original one-at-a-time code did, rather than multiplying by reciprocals, so gives the same results
+      // bit for bit...
+      template <typename G>
+      void interpolate(G CG, const double* __restrict__ l, const std::size_t n, double* __restrict__ out) const {
+        const double* __restrict__ table = curves.data();
+        const double* __restrict__ loads = load.data();
+        const double* __restrict__ span  = gap.data();
+        const double               first = pFail[0];
+        const double               min   = minLoad;
+        const double               delta = deltaLoad;
+        const int                  nL    = numLoads;
+        const int                  nCG   = numCG;
+        for(std::size_t i=0; i<n; i++){
+          // Make sure the CG is in range (else return something that won't break the callers code)...
+          const int  cg    = CG(i);
+          const bool valid = unsigned(cg - 1) < unsigned(nCG);
+          const int  base  = (valid ? cg - 1 : 0)*nL;
+
+          // Get the index of the load (clamped, so that loads off either end, or that aren't numbers, still read the table)...
+          double x = (l[i] - min) / delta;
+          x = x > 0 ? x : 0;
+          x = x < nL - 2 ? x : nL - 2;
+          const int index = int(x);
+
+          // Get the weight to the lower and upper values (capped, so loads off the end get the last value)...
+          double w = (l[i] - loads[index]) / span[index];
+          w = w < 1 ? w : 1;
+          w = w > 0 ? w : 0;
+          const double A = 1 - w;
+
+          // Find the lower and upper bound of the incoming load (reading both, even for a CG out of range, so nothing is masked)...
+          const double lower = table[base + index];
+          const double upper = table[base + index + 1];
+
+          // Return the calculated pFail value (guarding on loads too small to trouble the scorers, which get the first in the file,
+          // as do loads that aren't numbers)...
+          const double p = valid ? A*lower + (1 - A)*upper : 0;
+          out[i] = !(l[i] > min) ? first : p;
+        }
+      }
 
-        // Find the lower and upper bound of the incoming load...
-        double lower = pFail.at(    index*numCG + (CG-1));
-        double upper = pFail.at((index+1)*numCG + (CG-1));
+      // Get the fragility associated with an asset at a given load (using linear interpolation)...
+      double probability(const int CG, const double l) const {
+        double p;
+        interpolate([CG](std::size_t){ return CG; }, &l, 1, &p);
+        return p;
+      }
 
-        // Get the weight to the lower and upper values...
-        double A = 1 - (l - load.at(index)) / (load.at(index+1) - load.at(index));
+      // Get the fragility at a batch of loads, each with its own CG (the same as calling probability for each)...
+      void probabilities(const int* CG, const double* l, const std::size_t n, double* out) const {
+        interpolate([CG](std::size_t i){ return CG[i]; }, l, n, out);
+      }
 
-        // Return the calculated pFail value to the caller...
-        return A*lower + (1 - A)*upper;
+      // ...or all with the same CG.
+      void probabilities(const int CG, const double* l, const std::size_t n, double* out) const {
+        interpolate([CG](std::size_t){ return CG; }, l, n, out);
       }
     };
   } // fragility
@@ -2,6 +2,7 @@
 #define GRAPH_H
 
 #include <vector>
+#include <algorithm>
 
 namespace oia_risk_model{
   namespace fragility{
@@ -14,8 +15,8 @@ namespace oia_risk_model{
         // We need to add an "anchor point" to the start of the graph, which is taken to be 0...
         X.push_back(0); Y.push_back(0);
 
-        // ...followed by all the points that have been specified...
-        for(std::size_t i=rp.size()-1; i>=0; i--){
+        // ...followed by all the points that have been specified (last first)...
+        for(std::size_t i=rp.size(); i-- > 0; ){
           X.push_back(1.0/double(rp.at(i)));
           Y.push_back(pFail.at(i));
         }
@@ -46,6 +47,43 @@ namespace oia_risk_model{
         return a;
       }
     };
+
+    // Kernel integrating the area under many curves at once (e.g. the annual probability of failure of many assets), where
+    // every curve has its points at the same annual probabilities (1/RP). As for Graph, each curve is anchored at 0, and closed
+    // out at an annual probability of 1 if need be, and is integrated by the trapezoidal rule (giving identical results)...
+    //   X:         annual probability of each point, increasing.
+    //   Y:         pFail of every curve at each point (Y[p][k] for curve k at point p), each row contiguous.
+    //   numPoints: number of points on each curve.
+    //   numCurves: number of curves.
+    //   out:       area under each curve.
+    inline void areas(const double* X, const double* const* Y, const std::size_t numPoints, const std::size_t numCurves, double* out){
+      if(numPoints == 0){
+        std::fill(out, out + numCurves, 0.0);
+        return;
+      }
+
+      // The first segment runs from the anchor at 0...
+      const double* y = Y[0];
+      for(std::size_t k=0; k<numCurves; k++)
+        out[k] = (X[0] * (0 + y[k]) / 2.0);
+
+      // ...then on through each pair of neighbouring points...
+      for(std::size_t p=1; p<numPoints; p++){
+        const double  base = X[p] - X[p-1];
+        const double* h1   = Y[p-1];
+        const double* h2   = Y[p];
+        for(std::size_t k=0; k<numCurves; k++)
+          out[k] += (base * (h1[k] + h2[k]) / 2.0);
+      }
+
+      // ...and finally to the closing anchor.
+      const double last = X[numPoints-1];
+      if(last < 1){
+        const double* h = Y[numPoints-1];
+        for(std::size_t k=0; k<numCurves; k++)
+          out[k] += ((1 - last) * (h[k] + (h[k] >= 1 ? 1 : 0)) / 2.0);
+      }
+    }
   } // fragility
 } // oia_risk_model
 
@@ -0,0 +1,217 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "exceptions.h"
+
+namespace oia_risk_model{
+  namespace utils{
+
+    // Helper function to hand the whole pages of a block of memory that is no longer needed (e.g. the part of a large vector that
+    // has been dealt with) back to the kernel. The memory stays valid, but reads as zeros from then on...
+    inline void releasePages(const void* begin, const void* end){
+      const std::uintptr_t page  = sysconf(_SC_PAGESIZE);
+      const std::uintptr_t first = (reinterpret_cast<std::uintptr_t>(begin) + page - 1) / page * page;
+      const std::uintptr_t last  = reinterpret_cast<std::uintptr_t>(end) / page * page;
+      if(last > first)
+        madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+    }
+
+    // Helper function to name a temporary file alongside the nominated one, unique to this process (and to each call within it),
+    // so that processes writing the same file at once never write over each other's temporary file...
+    inline std::string temporaryName(const std::string fileName){
+      static std::atomic<unsigned> count(0);
+      return fileName + ".tmp." + std::to_string(getpid()) + "." + std::to_string(count++);
+    }
+
+    // Helper function to move a temporary file written alongside the nominated one into place in a single step, so that readers
+    // see either the old file or the new one, never part of either. Returns false (having removed the temporary file) if the
+    // temporary file wasn't written properly, or can't be moved...
+    inline bool replaceFile(const std::string tmp, const std::string fileName, const bool written=true){
+      if(written && std::rename(tmp.c_str(), fileName.c_str()) == 0)
+        return true;
+      std::remove(tmp.c_str());
+      return false;
+    }
+
+    // Read-only memory map of a file on disk (NOTE: pages are shared with any other process mapping the same file)...
+    struct MappedFile{
+      int         fd = -1;          // File descriptor of the mapped file
+      char*       bytes = nullptr;  // Start of the mapped region
+      std::size_t length = 0;       // Number of bytes mapped
+      std::size_t released = 0;     // Number of bytes at the start of the mapping handed back to the kernel (see release)
+
+      // Map the nominated file into memory...
+      MappedFile(const std::string fileName){
+        fd = open(fileName.c_str(), O_RDONLY);
+        if(fd < 0)
+          Exception("Unable to open file for mapping (" + fileName + ")");
+
+        // Find out how much there is to map...
+        struct stat st;
+        if(fstat(fd, &st) != 0)
+          Exception("Unable to stat file for mapping (" + fileName + ")");
+        length = st.st_size;
+
+        // An empty file is valid, but can't be mapped...
+        if(length == 0)
+          return;
+
+        void* p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED)
+          Exception("Unable to map file (" + fileName + ")");
+        bytes = static_cast<char*>(p);
+      }
+
+      // The mapping owns the file descriptor, so it can't be copied...
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+
+      // Unmap and close the file...
+      ~MappedFile(){
+        if(bytes)
+          munmap(bytes, length);
+        if(fd >= 0)
+          close(fd);
+      }
+
+      // Accessors for the mapped bytes...
+      const char* data(void) const { return bytes; }
+      std::size_t size(void) const { return length; }
+
+      // Let the kernel drop the pages before a point in the mapping from memory, e.g. once they have been read (they are read back
+      // in from the file if they are touched again)...
+      void release(const char* upto){
+        if(!bytes)
+          return;
+
+        const std::size_t page = sysconf(_SC_PAGESIZE);
+        const std::size_t n    = std::size_t(upto - bytes) / page * page;
+        if(n > released){
+          madvise(bytes + released, n - released, MADV_DONTNEED);
+          released = n;
+        }
+      }
+    };
+
+    // Index of where each line starts in a mapped file, so any line can be fetched without reading the ones before it (the
+    // mapping is shared, so copies of the index are cheap)...
+    struct LineIndex{
+      std::shared_ptr<MappedFile> file;     // The mapped file
+      std::vector<std::size_t>    offsets;  // Byte offset of the start of each line, plus the end of the file
+
+      LineIndex() {}
+
+      // Map the nominated file and index (up to numLines of) its lines, padding with empty lines if the file is short...
+      LineIndex(const std::string fileName, const std::size_t numLines) : file(std::make_shared<MappedFile>(fileName)){
+        offsets.reserve(numLines + 1);
+
+        const char* begin = file->data();
+        const char* end   = begin + file->size();
+        const char* p     = begin;
+        while(offsets.size() < numLines && p < end){
+          offsets.push_back(p - begin);
+          const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+          p = eol ? eol + 1 : end;
+        }
+        offsets.resize(numLines + 1, p - begin);
+      }
+
+      // Number of lines in the index...
+      std::size_t size(void) const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+      // Helper method to get a line (without its newline)...
+      std::string_view line(const std::size_t k) const {
+        std::size_t n = offsets[k+1] - offsets[k];
+        if(n > 0 && file->data()[offsets[k+1] - 1] == '\n')
+          n--;
+        return std::string_view(file->data() + offsets[k], n);
+      }
+    };
+
+    // Scratch matrix of doubles (rows x columns, stored column-major so each column is contiguous), held in a memory-mapped
+    // temporary file so it needn't fit in memory. The file starts out as zeros, and is removed as soon as it has been mapped...
+    struct ScratchMatrix{
+      int         fd = -1;            // File descriptor of the (already unlinked) scratch file
+      double*     values = nullptr;   // Start of the mapped matrix
+      std::size_t numRows = 0;        // Number of rows (e.g. features)
+      std::size_t numColumns = 0;     // Number of columns (e.g. rasters)
+
+      // Number of rows (and columns) in each tile of a transpose...
+      static const std::size_t TILE = 64;
+
+      // Create the matrix in a scratch file in the nominated directory...
+      ScratchMatrix(const std::size_t numRows, const std::size_t numColumns, const std::string directory=".")
+        : numRows(numRows), numColumns(numColumns){
+        std::string name = directory + "/oia_scratch_XXXXXX";
+        fd = mkstemp(&name[0]);
+        if(fd < 0)
+          Exception("Unable to create scratch file in " + directory);
+        unlink(name.c_str());
+
+        const std::size_t length = size();
+        if(length == 0)
+          return;
+        if(ftruncate(fd, length) != 0)
+          Exception("Unable to size scratch file (" + std::to_string(length) + " bytes)");
+
+        void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(p == MAP_FAILED)
+          Exception("Unable to map scratch file");
+        values = static_cast<double*>(p);
+      }
+
+      // The mapping owns the file descriptor, so it can't be copied...
+      ScratchMatrix(const ScratchMatrix&) = delete;
+      ScratchMatrix& operator=(const ScratchMatrix&) = delete;
+
+      // Unmap and close the file (which disappears with it)...
+      ~ScratchMatrix(){
+        if(values)
+          munmap(values, size());
+        if(fd >= 0)
+          close(fd);
+      }
+
+      // Number of bytes in the matrix...
+      std::size_t size(void) const { return numRows*numColumns*sizeof(double); }
+
+      // Accessors for a column, and a single value...
+      double*       column(const std::size_t c)       { return values + c*numRows; }
+      const double* column(const std::size_t c) const { return values + c*numRows; }
+      double&       operator()(const std::size_t r, const std::size_t c)       { return values[c*numRows + r]; }
+      double        operator()(const std::size_t r, const std::size_t c) const { return values[c*numRows + r]; }
+
+      // Helper method to copy rows [begin, end) out row-major (numColumns values per row). This is done a tile at a time, so the
+      // stretch of each column being read and the rows being written both stay in cache...
+      void rows(const std::size_t begin, const std::size_t end, double* out) const {
+        for(std::size_t r0=begin; r0<end; r0+=TILE){
+          const std::size_t r1 = std::min(end, r0 + TILE);
+          for(std::size_t c0=0; c0<numColumns; c0+=TILE){
+            const std::size_t c1 = std::min(numColumns, c0 + TILE);
+            for(std::size_t c=c0; c<c1; c++){
+              const double* col = column(c);
+              for(std::size_t r=r0; r<r1; r++)
+                out[(r - begin)*numColumns + c] = col[r];
+            }
+          }
+        }
+      }
+    };
+  } // utils
+} // oia_risk_model
+
+#endif //MAPPED_FILE_H
@@ -3,64 +3,579 @@
 
 #include <iostream>
 #include <iomanip>
+#include <numeric>
+#include <string_view>
+#include <functional>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
 
 #include "exceptions.h"
 #include "utils.h"
+#include "mapped_file.h"
 #include "features.h"
 #include "raster.h"
 #include "fragility.h"
 #include "cost_function.h"
 #include "graph.h"
+#include "parallel.h"
+#include "exposure.h"
 
 namespace oia_risk_model{
+  // Header of the binary cache of a MIF / MID pair (the features and attributes follow, see MIF::writeBinary)...
+  struct BinaryMIFHeader{
+    char          magic[8];        // Always "OIAMIF" (used to recognise the file)
+    std::int32_t  version;         // Version of the binary format
+    std::int32_t  region;          // Does the MIF file describe regions?
+    std::uint64_t numFeatures;     // Number of features in the file
+    std::uint64_t numPoints;       // Number of points across all the features
+    std::uint64_t numColumns;      // Number of attribute columns
+    char          padding[24];     // Pads the header to 64 bytes, so the data is aligned
+  };
+  static_assert(sizeof(BinaryMIFHeader) == 64, "Binary MIF header must be 64 bytes");
+
+  // Constants identifying the binary MIF format...
+  const char         BINARY_MIF_MAGIC[8] = "OIAMIF";
+  const std::int32_t BINARY_MIF_VERSION  = 3;
+
+  // Number of features each thread encodes at a time when writing a MIF / MID...
+  const std::size_t  WRITE_CHUNK = 16384;
+
+  // Number of features divided at a time, before the memory they took up is handed back (see MIF::divide)...
+  const std::size_t  DIVIDE_BLOCK = 65536;
+
+  // Number of assets whose risk is calculated at a time...
+  const std::size_t  RISK_BLOCK  = 512;
+
+  // Helper function to name the binary cache of a MIF / MID pair (given the name without an extension)...
+  inline std::string binaryMIFName(const std::string filename){
+    return filename + ".mif.bin";
+  }
+
+  // Helper function to read the header of a binary MIF (returns false if the file isn't a binary MIF of the current version)...
+  inline bool readBinaryMIFHeader(const std::string filename, BinaryMIFHeader& h){
+    std::ifstream infile(filename, std::ios::in | std::ios::binary);
+    if(!infile.read((char*)&h, sizeof(h)))
+      return false;
+    return std::memcmp(h.magic, BINARY_MIF_MAGIC, sizeof(h.magic)) == 0 && h.version == BINARY_MIF_VERSION;
+  }
+
   // MapInfo data type, contains internal representatin / methods for polylines and regions
   struct MIF{
     std::string              _fileName;         // When reading the file "Just In time", we need to preserve the filename
     bool                     justInTime=false;  // Should the heavy-data (.mid) be read at once, or defered to later?
     bool                     region=false;      // Does the MIF file describe regions?
     std::vector<std::string> header;            // Verbatim representation of the header of the MIF file
-    std::vector<Feature>     features;          // Vector of features in the file
+    FeatureStore             features;          // Flat store of the features in the file
     std::vector<bool>        dropFeature;       // Vector of bools indicating feature can safely be discarded before write-out
     std::vector<std::string> columns;           // String representation of the attribute names
+    std::size_t              numFileColumns=0;  // Number of the columns that were read from the file (the rest have been added since)
     std::vector<bool>        dropColumn;        // Vector of bools indicating whether the attribute (column) should be dropped before writing
-    // Helper function to read the header of the MIF file...
-    bool readHeader(std::ifstream* infile){
+    std::vector<std::size_t> midLine;           // Line of the .mid holding the attributes of each feature
+    utils::LineIndex         mid;               // Index of the lines of the .mid, when the read-in of the heavy-data is being defered
+    // Helper function to read the header of the MIF file, and the declaration of each column...
+    static bool readHeader(utils::LineCursor& mif, std::vector<std::string>& header, std::vector<std::string>& columns){
         // Put some space aside to read the file...
-        std::string line = "";
+        std::string_view line;
 
         // Read the file until we hit the word "Data" which signifies the start of the feature information...
         while(line.substr(0,4) != "Data"){
-          std::getline(*infile, line);
+          if(!mif.next(line))
+            return false;
+
           if(line.length() > 0){
             if(line.substr(0,7) == "Columns"){
               // We want to read the column details into their own vector...
-              std::vector<std::string> words = utils::readLine(line, ' ');
-              int numCols = std::stoi(words.at(1));
+              std::vector<std::string_view> words;
+              utils::splitLine(line, ' ', words);
+              int numCols = utils::parseNumber<int>(words.at(1));
 
-              std::string colLine;
+              std::string_view colLine;
               for(int i=0; i<numCols; i++){
-                std::getline(*infile, colLine);
-                columns.push_back(colLine);
-                dropColumn.push_back(false);
+                mif.next(colLine);
+                columns.emplace_back(colLine);
               }
             }
 
             // Stick the header line on the header vector APART from the keywords "Data" and "Columns"
             // which are derived from the stored data...
             if(line.substr(0,4) != "Data" && line.substr(0,7) != "Columns")
-              header.push_back(line);
+              header.emplace_back(line);
           }
         }
 
         // And finally, read one extra line (which should be blank in a vlid MIF file)...
-        std::getline(*infile, line);
+        line = std::string_view();
+        mif.next(line);
 
         // Indicate the caller can now safely read the data from the rest of the file...
         return line.length() <= 1;
     }
 
+    // Helper function to close the loop of a region's geometry, as Poly2 does...
+    static void closeRegion(std::vector<geometry::Vec2<double>>& geom){
+      if(geom.size() > 1 && geometry::Line2<double>(geom.front(), geom.back()).length() > 0)
+        geom.push_back(geom.front());
+    }
+
+    // Helper function to index the next entity (a Line, Pline or Region) in the body of a MIF file without parsing its points,
+    // returning the start of the entity (or nullptr if there are no entities left). Handles the ogr2ogr "Line x1 y1 x2 y2",
+    // "Pline n" and "Region n" forms, and the QGIS "Pline Multiple n" form (with the number of points on the next line)...
+    //   region:      set once a Region has been seen (after which every entity is treated as a region, as before).
+    //   numFeatures: the number of features in the entity.
+    //   numPoints:   the most points the entity's features can hold (allowing for each region being closed).
+    static const char* indexEntity(utils::LineCursor& mif, bool& region, std::size_t& numFeatures, std::size_t& numPoints){
+      // Skip any blank lines between the entities...
+      std::string_view line;
+      const char* start;
+      do{
+        start = mif.p;
+        if(!mif.next(line))
+          return nullptr;
+      }while(line.size() == 0);
+
+      // Extract the words from the line...
+      std::vector<std::string_view> words;
+      utils::splitLine(line, ' ', words);
+
+      // Work out how many features are in the entity, and how many points in the first...
+      std::size_t points = 0;
+      if(words.size() == 2){
+        if(words.at(0) == "Region"){
+          region = true;
+          numFeatures = utils::parseNumber<int>(words.at(1));
+          mif.next(line);
+          points = utils::parseNumber<int>(line);
+        }else{
+          numFeatures = 1;
+          points = utils::parseNumber<int>(words.at(1));
+        }
+      }else if(words.size() == 3){
+        numFeatures = 1;
+        mif.next(line);
+        points = utils::parseNumber<int>(line);
+      }else if(words.size() == 5){
+        numFeatures = 1;
+        numPoints   = 2 + region;
+      }else{
+        // No idea what this is: Stop and complain bitterly...
+        Exception("Unknown feature-type");
+        return nullptr;
+      }
+
+      // Skip over the points of each feature...
+      if(words.size() != 5){
+        numPoints = 0;
+        for(std::size_t j=0; j<numFeatures; j++){
+          if(j > 0 && region){
+            mif.next(line);
+            points = utils::parseNumber<int>(line);
+          }
+          numPoints += points + region;
+          for(std::size_t i=0; i<points; i++)
+            mif.next(line);
+        }
+      }
+
+      // ...and the pen (and brush, for regions) at the end of the entity.
+      mif.next(line);
+      if(region)
+        mif.next(line);
+
+      return start;
+    }
+
+    // Helper function to read the entity at the start of a cursor, calling addFeature(geom) with the geometry of each of its
+    // features in turn (see indexEntity for the forms handled)...
+    //   region: is the entity to be treated as a region (i.e. have its loops closed)?
+    //   geom:   scratch space for building the geometry of each feature.
+    template <typename F>
+    static void readEntity(utils::LineCursor& mif, const bool region, std::vector<geometry::Vec2<double>>& geom, F addFeature){
+      std::string_view line;
+      mif.next(line);
+
+      // Extract the words from the line...
+      std::vector<std::string_view> words;
+      utils::splitLine(line, ' ', words);
+
+      // Somewhere to store the number of regions in the entity...
+      int numFeatures = -1;
+      int numPoints   = 0;
+
+      // ogr2ogr adds numPoints data to the Line or Pline string...
+      if(words.size() == 2){
+        numFeatures = words.at(0) == "Region" ? utils::parseNumber<int>(words.at(1)) : 1;
+
+        // ogr2ogr Region element - the number of points for the first feature comes next...
+        if(words.at(0) == "Region"){
+          mif.next(line);
+          numPoints = utils::parseNumber<int>(line);
+        }else{
+          numPoints = utils::parseNumber<int>(words.at(1));
+        }
+      }else if(words.size() == 3){
+        // QGIS Pline element - size on next line...
+        mif.next(line);
+        numPoints = utils::parseNumber<int>(line);
+        numFeatures = 1;
+      }else if(words.size() == 5){
+        // ogr2ogr Line element - data read-in on the same line...
+        geom.clear();
+        geom.emplace_back(utils::parseNumber<double>(words.at(1)), utils::parseNumber<double>(words.at(2)));
+        geom.emplace_back(utils::parseNumber<double>(words.at(3)), utils::parseNumber<double>(words.at(4)));
+        if(region)
+          closeRegion(geom);
+        addFeature(geom);
+      }
+
+      // Loop over each of the features / regions...
+      for(int j=0; j<numFeatures; j++){
+        // Start a new geometry...
+        geom.clear();
+
+        // For the second and later features / regions we need to read the number of points...
+        if(j > 0 && region){
+          mif.next(line);
+          numPoints = utils::parseNumber<int>(line);
+        }
+
+        // Loop over each point in the file...
+        for(int i=0; i<numPoints; i++){
+          // Split the point line into words...
+          mif.next(line);
+          utils::splitLine(line, ' ', words);
+
+          // Parse the point into its Lat, Lon pair and save in the feature geometery...
+          if(words.size() == 2)
+            geom.emplace_back(utils::parseNumber<double>(words[0]), utils::parseNumber<double>(words[1]));
+        }
+
+        // Hand the feature over...
+        if(region)
+          closeRegion(geom);
+        addFeature(geom);
+      }
+    }
+
+    // Helper function to parse entities found by indexEntity in parallel, straight into a store of features (whose attributes are
+    // left missing). Entity k starts at entities[k], and its features go in firstFeature[k] to firstFeature[k+1]-1 with room for
+    // firstPoint[k+1]-firstPoint[k] points between them. The entities from firstRegion on are regions...
+    static void readEntities(const std::vector<const char*>& entities, const std::vector<std::size_t>& firstFeature,
+                             const std::vector<std::size_t>& firstPoint, const std::size_t firstRegion, const char* mif_end,
+                             FeatureStore& features, const int threads=0){
+      // Make room for everything (the offsets hold the number of points in each feature until the parse is done)...
+      features.resize(firstFeature.back(), firstPoint.back());
+      std::vector<std::size_t> start(features.size());
+
+      // Parse the entities in parallel, each writing its features into the space set aside for it...
+      parallel::forChunks(entities.size(), threads, [&](std::size_t, std::size_t begin, std::size_t end){
+        std::vector<geometry::Vec2<double>> geom;
+        for(std::size_t k=begin; k<end; k++){
+          std::size_t f  = firstFeature[k];
+          std::size_t pt = firstPoint[k];
+          utils::LineCursor entity(entities[k], mif_end);
+          readEntity(entity, k >= firstRegion, geom, [&](const std::vector<geometry::Vec2<double>>& g){
+            if(f >= firstFeature[k+1] || pt + g.size() > firstPoint[k+1])
+              Exception("MIF entity does not match its description");
+            std::copy(g.begin(), g.end(), features.coords.begin() + pt);
+            start[f] = pt;
+            features.offsets[f+1] = g.size();
+            pt += g.size();
+            f++;
+          });
+        }
+      });
+
+      // Close up any space left over (e.g. by regions that were already closed), and fill in the offsets...
+      std::size_t used = 0;
+      for(std::size_t f=0; f<features.size(); f++){
+        std::size_t n = features.offsets[f+1];
+        if(start[f] != used)
+          std::copy(features.coords.begin() + start[f], features.coords.begin() + start[f] + n, features.coords.begin() + used);
+        features.offsets[f] = used;
+        used += n;
+      }
+      features.offsets[features.size()] = used;
+      features.coords.resize(used);
+
+      // Finally, give each feature a BB...
+      parallel::forChunks(features.size(), threads, [&](std::size_t, std::size_t begin, std::size_t end){
+        for(std::size_t i=begin; i<end; i++)
+          if(features.numPoints(i) > 0)
+            features.addBB(i);
+      });
+    }
+
+    // Function to read the text of a MIF file. Both files are mapped into memory and read in two passes: the first finds where
+    // each entity starts in the .mif (and each line in the .mid), so the second can parse the entities in parallel straight into
+    // the store (threads = 0 means use all cores)...
+    void readText(const std::string f_n, const bool isUpperCase, const int threads=0){
+      // Map the .mif file...
+      utils::MappedFile mif_file(f_n + (isUpperCase ? ".MIF" : ".mif"));
+      const char*       mif_end = mif_file.data() + mif_file.size();
+      utils::LineCursor mif(mif_file.data(), mif_end);
+
+      // Get the header out of the way...
+      bool allGood = readHeader(mif, header, columns);
+      dropColumn.assign(columns.size(), false);
+      if(!allGood)return;
+
+      // The Columns declaration gives the type of each attribute (whose values stay on disk if they're being read just in time)...
+      for(const auto& c : columns)
+        features.attributes.addColumn(attributeType(c), justInTime);
+      numFileColumns = columns.size();
+
+      // First pass: find the start of each entity, and where its features and points go in the store...
+      std::vector<const char*> entities;
+      std::vector<std::size_t> firstFeature(1, 0);
+      std::vector<std::size_t> firstPoint(1, 0);
+      std::size_t              firstRegion = std::string::npos;
+      std::size_t              numFeatures, numPoints;
+      while(const char* start = indexEntity(mif, region, numFeatures, numPoints)){
+        if(region && firstRegion == std::string::npos)
+          firstRegion = entities.size();
+        entities.push_back(start);
+        firstFeature.push_back(firstFeature.back() + numFeatures);
+        firstPoint.push_back(firstPoint.back() + numPoints);
+      }
+
+      // ...and each line in the .mid.
+      utils::LineIndex midIndex(f_n + (isUpperCase ? ".MID" : ".mid"), entities.size());
+
+      // Second pass: parse the entities in parallel, each writing its features into the space set aside for it...
+      readEntities(entities, firstFeature, firstPoint, firstRegion, mif_end, features, threads);
+
+      // The attributes for each of the entity's features come from a single line of the .mid...
+      midLine.resize(features.size());
+      for(std::size_t k=0; k<entities.size(); k++)
+        std::fill(midLine.begin() + firstFeature[k], midLine.begin() + firstFeature[k+1], k);
+
+      // ...which are either parsed now, or left until they're needed.
+      if(justInTime){
+        mid = std::move(midIndex);
+      }else{
+        std::vector<std::string_view> midLines(entities.size());
+        for(std::size_t k=0; k<entities.size(); k++)
+          midLines[k] = midIndex.line(k);
+        features.attributes.parse(midLines, firstFeature, threads);
+      }
+
+      // ...and assume that they all matter, for now.
+      dropFeature.assign(features.size(), false);
+    }
+
+    // Helper function to get the attributes of features [begin, end) as rows 0 to end-begin of a new table: the columns read from
+    // the file are parsed from the .mid if the read-in has been defered (each line once, however many features share it), and the
+    // rest are copied from memory...
+    AttributeTable attributeRows(const std::size_t begin, const std::size_t end, const int threads=0) const {
+      AttributeTable table;
+      table.numRows = end - begin;
+      for(const auto& c : features.attributes.columns){
+        if(c.deferred)
+          table.addColumn(c.type);
+        else
+          table.columns.push_back(c.slice(begin, end));
+      }
+
+      if(!justInTime || numFileColumns == 0)
+        return table;
+
+      // Find the distinct lines holding the features' attributes...
+      std::vector<std::string_view> lines;
+      std::vector<std::size_t>      firstRow;
+      for(std::size_t i=begin; i<end; i++){
+        if(i == begin || midLine[i] != midLine[i-1]){
+          lines.push_back(mid.line(midLine[i]));
+          firstRow.push_back(i - begin);
+        }
+      }
+      firstRow.push_back(end - begin);
+
+      // ...and parse them into the file's columns.
+      AttributeTable file;
+      for(std::size_t c=0; c<numFileColumns; c++)
+        file.addColumn(table[c].type);
+      file.parse(lines, firstRow, threads);
+      for(std::size_t c=0; c<numFileColumns; c++)
+        std::swap(table[c], file[c]);
+      return table;
+    }
+
+    // Helper function to work through the attributes of the features a block at a time, calling fn(table, first, begin, end) for
+    // each block of features [begin, end), whose attributes are held in rows i - first of the table. With the attributes in memory
+    // there's a single block (the features' own attributes), otherwise the .mid is read blockSize features at a time (NOTE: a
+    // block never ends on a dropped feature, so a feature and the dropped ones after it are always seen together)...
+    template <typename F>
+    void forAttributeBlocks(F fn, const std::size_t blockSize=65536, const int threads=0) const {
+      if(!justInTime){
+        fn(features.attributes, std::size_t(0), std::size_t(0), features.size());
+        return;
+      }
+
+      std::size_t begin = 0;
+      while(begin < features.size()){
+        std::size_t end = std::min(features.size(), begin + blockSize);
+        while(end < features.size() && dropFeature.at(end))
+          end++;
+
+        fn(attributeRows(begin, end, threads), begin, begin, end);
+        begin = end;
+      }
+    }
+
+    // Helper function to write a list of strings to a binary file (the count, the offset of each string, then the characters)...
+    static void writeStrings(std::ofstream& b, const std::size_t count, const std::function<const std::string&(std::size_t)>& at){
+      std::vector<std::uint64_t> offsets(count + 1, 0);
+      for(std::size_t i=0; i<count; i++)
+        offsets[i+1] = offsets[i] + at(i).size();
+
+      std::uint64_t n = count;
+      b.write((char*)&n, sizeof(n));
+      b.write((char*)offsets.data(), offsets.size()*sizeof(std::uint64_t));
+      for(std::size_t i=0; i<count; i++)
+        b.write(at(i).data(), at(i).size());
+    }
+
+    // Helper function to take the next block of bytes from a binary file in memory, complaining if the file is too short...
+    static const char* take(const char*& p, const char* end, const std::size_t bytes, const std::string& filename){
+      if(std::size_t(end - p) < bytes)
+        Exception("The binary MIF is truncated (" + filename + ")");
+      const char* block = p;
+      p += bytes;
+      return block;
+    }
+
+    // Helper function to read a list of strings written by writeStrings, calling set(i, string) for each...
+    template <typename F>
+    static void readStrings(const char*& p, const char* end, const std::string& filename, F set){
+      std::uint64_t n;
+      std::memcpy(&n, take(p, end, sizeof(n), filename), sizeof(n));
+
+      std::vector<std::uint64_t> offsets(n + 1);
+      std::memcpy(offsets.data(), take(p, end, offsets.size()*sizeof(std::uint64_t), filename), offsets.size()*sizeof(std::uint64_t));
+
+      const char* chars = take(p, end, offsets.back(), filename);
+      for(std::size_t i=0; i<n; i++)
+        set(i, std::string_view(chars + offsets[i], offsets[i+1] - offsets[i]));
+    }
+
+    // Write the features and attributes to a binary file, so they can be loaded without parsing next time. After the header
+    // come the MIF header lines and columns, the feature offsets, points, bounding boxes and .mid lines, the type of each attribute
+    // column and then the columns themselves (the values of numeric columns, or the dictionary and codes of string columns)...
+    void writeBinary(const std::string filename) const {
+      const AttributeTable& table = features.attributes;
+
+      BinaryMIFHeader h;
+      std::memset(&h, 0, sizeof(h));
+      std::memcpy(h.magic, BINARY_MIF_MAGIC, sizeof(h.magic));
+      h.version     = BINARY_MIF_VERSION;
+      h.region      = region;
+      h.numFeatures = features.size();
+      h.numPoints   = features.coords.size();
+      h.numColumns  = table.numColumns();
+
+      // Write to a temporary file of our own first, so other processes never read a partially written file...
+      std::string tmp = utils::temporaryName(filename);
+      std::ofstream b(tmp, std::ios::out | std::ios::binary);
+      b.write((char*)&h, sizeof(h));
+
+      // The header and columns of the MIF file...
+      writeStrings(b, header.size(), [&](std::size_t i) -> const std::string& { return header[i]; });
+      writeStrings(b, columns.size(), [&](std::size_t i) -> const std::string& { return columns[i]; });
+
+      // ...the geometry of the features...
+      std::vector<std::uint64_t> offsets(features.offsets.begin(), features.offsets.end());
+      b.write((char*)offsets.data(), offsets.size()*sizeof(std::uint64_t));
+      b.write((char*)features.coords.data(), features.coords.size()*sizeof(geometry::Vec2<double>));
+      for(auto v : {&features.llx, &features.lly, &features.urx, &features.ury})
+        b.write((char*)v->data(), v->size()*sizeof(double));
+      std::vector<std::uint64_t> lines(midLine.begin(), midLine.end());
+      b.write((char*)lines.data(), lines.size()*sizeof(std::uint64_t));
+
+      // ...and their attributes.
+      for(const auto& c : table.columns)
+        b.write((char*)&c.type, sizeof(c.type));
+      for(const auto& c : table.columns){
+        if(c.type == FLOAT){
+          b.write((char*)c.floats.data(), c.floats.size()*sizeof(double));
+        }else if(c.type == INTEGER){
+          b.write((char*)c.integers.data(), c.integers.size()*sizeof(std::int64_t));
+        }else{
+          writeStrings(b, c.dictionary->values.size(), [&](std::size_t i) -> const std::string& { return c.dictionary->values[i]; });
+          b.write((char*)c.codes.data(), c.codes.size()*sizeof(std::uint32_t));
+        }
+      }
+      b.close();
+
+      // ...then move it into place (if that fails, a file put there by another process will do just as well).
+      BinaryMIFHeader existing;
+      if(!utils::replaceFile(tmp, filename, bool(b)) && !readBinaryMIFHeader(filename, existing))
+        Exception("Unable to write binary MIF (" + filename + ")");
+    }
+
+    // Read the features and attributes from a binary file written by writeBinary (the attributes are left on disk if the
+    // heavy-data is being read just in time)...
+    void readBinary(const std::string filename){
+      utils::MappedFile file(filename);
+      const char* p   = file.data();
+      const char* end = p + file.size();
+
+      BinaryMIFHeader h;
+      std::memcpy(&h, take(p, end, sizeof(h), filename), sizeof(h));
+      region = h.region;
+
+      // The header and columns of the MIF file...
+      readStrings(p, end, filename, [&](std::size_t, std::string_view s){ header.emplace_back(s); });
+      readStrings(p, end, filename, [&](std::size_t, std::string_view s){ columns.emplace_back(s); dropColumn.push_back(false); });
+      numFileColumns = columns.size();
+      if(h.numColumns != columns.size())
+        Exception("The binary MIF has the wrong number of attribute columns (" + filename + ")");
+
+      // ...the geometry of the features...
+      std::vector<std::uint64_t> offsets(h.numFeatures + 1);
+      std::memcpy(offsets.data(), take(p, end, offsets.size()*sizeof(std::uint64_t), filename), offsets.size()*sizeof(std::uint64_t));
+      features.resize(h.numFeatures, h.numPoints);
+      std::copy(offsets.begin(), offsets.end(), features.offsets.begin());
+      std::memcpy(features.coords.data(), take(p, end, h.numPoints*sizeof(geometry::Vec2<double>), filename),
+                  h.numPoints*sizeof(geometry::Vec2<double>));
+      for(auto v : {&features.llx, &features.lly, &features.urx, &features.ury})
+        std::memcpy(v->data(), take(p, end, h.numFeatures*sizeof(double), filename), h.numFeatures*sizeof(double));
+      std::vector<std::uint64_t> lines(h.numFeatures);
+      std::memcpy(lines.data(), take(p, end, lines.size()*sizeof(std::uint64_t), filename), lines.size()*sizeof(std::uint64_t));
+      midLine.assign(lines.begin(), lines.end());
+
+      // ...and their attributes.
+      AttributeTable& table = features.attributes;
+      for(std::size_t c=0; c<h.numColumns; c++){
+        AttributeType type;
+        std::memcpy(&type, take(p, end, sizeof(type), filename), sizeof(type));
+        table.addColumn(type, justInTime);
+      }
+
+      if(!justInTime){
+        for(auto& c : table.columns){
+          if(c.type == FLOAT){
+            std::memcpy(c.floats.data(), take(p, end, h.numFeatures*sizeof(double), filename), h.numFeatures*sizeof(double));
+          }else if(c.type == INTEGER){
+            std::memcpy(c.integers.data(), take(p, end, h.numFeatures*sizeof(std::int64_t), filename), h.numFeatures*sizeof(std::int64_t));
+          }else{
+            c.dictionary = std::make_shared<StringDictionary>();
+            readStrings(p, end, filename, [&](std::size_t, std::string_view s){ c.encode(s); });
+            std::memcpy(c.codes.data(), take(p, end, h.numFeatures*sizeof(std::uint32_t), filename), h.numFeatures*sizeof(std::uint32_t));
+          }
+        }
+      }
+
+      // None of the features are being dropped...
+      dropFeature.assign(features.size(), false);
+    }
+
     // Function to read MIF file...
-    MIF(const std::string file_name, bool const justInTime=false) : _fileName(file_name), justInTime(justInTime){
+    //   threads: number of threads used to parse the text (0 means use all cores).
+    //   cache:   keep a binary copy of the features and attributes next to the file, and read that instead whenever it is
+    //            up-to-date (a copy is only written when the attributes are being read).
+    MIF(const std::string file_name, bool const justInTime=false, const int threads=0, const bool cache=false)
+      : _fileName(file_name), justInTime(justInTime){
       // Test that the incoming file actually exists...
       utils::mifExists(file_name);
 
@@ -80,167 +595,38 @@ namespace oia_risk_model{
           isUpperCase = true;
       }
 
-      // Open the .mif file...
-      std::ifstream mif_file;
-      if(!isUpperCase)
-        mif_file.open(f_n + ".mif");
-      else
-        mif_file.open(f_n + ".MIF");
-
-      // Open the .mid file...
-      std::ifstream mid_file;
-      if(!isUpperCase)
-        mid_file.open(f_n + ".mid");
-      else
-        mid_file.open(f_n + ".MID");
-
-      // Create some strings to read the file into...
-      std::string mif_line[2];
-      std::string pen_line;
-      std::string point_line;
-      std::string mid_line;
-
-      // Get the header out of the way...
-      bool allGood = readHeader(&mif_file);
-      if(!allGood)return;
-
-      // And then loop over the body of the file, looking for data...
-      while (!mif_file.eof()){
-        // Somewhere to store the number of regions in the file...
-        int numFeatures = -1;
-
-        // The first two line in the entity description will be the line-type and number of points...
-        std::getline(mif_file, mif_line[0]);
-
-        if(mif_line[0].size() > 0){
-          // Create somewhere to build the representation of the mif geometric feature...
-          std::vector<Feature> fs;
-
-          // Extract the data from the line...
-          std::vector<std::string> mif_words = utils::readLine(mif_line[0], ' ');
-
-          int numPoints = 0;
-
-          // ogr2ogr adds numPoints data to the Line or Pline string...
-          if(mif_words.size() == 2){
-            // ogr2ogr Pline element...
-            if(mif_words.at(0) == "Region"){
-              // We are dealing with regions...
-              region = true;
-              numFeatures = std::stoi(mif_words.at(1));
-
-              // The number of points for the first feature comes next...
-              std::getline(mif_file, mif_line[1]);
-              numPoints = std::stoi(mif_line[1]);
-            }else{
-              numPoints = std::stoi(mif_words.at(1));
-              numFeatures = 1;
-            }
-          }else if(mif_words.size() == 3){
-            // QGIS Pline element - size on next line...
-            std::getline(mif_file, mif_line[1]);
-            numPoints = std::stoi(mif_line[1]);
-            numFeatures = 1;
-          } else if(mif_words.size() == 5){
-            // ogr2ogr Line element - data read-in on the same line...
-            geometry::Vec2<double> pt1(std::stod(mif_words.at(1)), std::stod(mif_words.at(2)));
-            geometry::Vec2<double> pt2(std::stod(mif_words.at(3)), std::stod(mif_words.at(4)));
-
-            // Create a geometry...
-            std::vector<geometry::Vec2<double>> geom;
-
-            // Give it some space...
-            geom.push_back(pt1);
-            geom.push_back(pt2);
-
-            // Create a new feature (Feature or Region) from the geom...
-            if(region){
-              Poly2 f(geom);
-              fs.push_back(f);
-            }else{
-              Feature f;
-              for(auto g : geom){
-                  f.geometry.push_back(g);
-              }
-              fs.push_back(f);
-            }
-          }else{
-            // No idea what this is: Stop and complain bitterly...
-            Exception("Unknown feature-type");
-            return;
-          }
-
-          // Loop over each of the features / regions...
-          for(int j=0; j<numFeatures; j++){
-            // Create a new geometry vector...
-            std::vector<geometry::Vec2<double>> geom;
-
-            // For the second and later features / regions we need to read the number of points...
-            if(j > 0 && region){
-                std::getline(mif_file, mif_line[1]);
-                numPoints = std::stoi(mif_line[1]);
-            }
-
-            // Loop over each point in the file...
-            for(int i=0; i<numPoints; i++){
-              // First, retrieve the point string...
-              std::getline(mif_file, point_line);
-
-              // Split the string into words...
-              std::vector<std::string> words = utils::readLine(point_line, ' ');
-
-              // Parse the point into its Lat, Lon pair and save in the feature geometery...
-              if(words.size() == 2){
-                  geometry::Vec2<double> pt(std::stod(words.at(0)),std::stod(words.at(1)));
-                  geom.push_back(pt);
-              }
-            }
+      // Is there an up-to-date binary copy of the file we can use instead?
+      std::string binFile = binaryMIFName(f_n);
+      std::string mifName = f_n + (isUpperCase ? ".MIF" : ".mif");
+      std::string midName = f_n + (isUpperCase ? ".MID" : ".mid");
+      BinaryMIFHeader h;
+      if(cache && readBinaryMIFHeader(binFile, h) &&
+         std::filesystem::last_write_time(binFile) >= std::filesystem::last_write_time(mifName) &&
+         std::filesystem::last_write_time(binFile) >= std::filesystem::last_write_time(midName)){
+        readBinary(binFile);
+
+        // Any attributes being read just in time come from the .mid itself...
+        if(justInTime)
+          mid = utils::LineIndex(midName, features.empty() ? 0 : midLine.back() + 1);
+        return;
+      }
 
-            // Create a new feature...
-            if(region){
-                Poly2 f(geom);
-              fs.push_back(f);
-            }else{
-              Feature f;
-              for(auto g : geom){
-                  f.geometry.push_back(g);
-              }
-              fs.push_back(f);
-            }
-          }
+      // Otherwise, parse the text...
+      readText(f_n, isUpperCase, threads);
 
-          // The features in the mif have a pen line that we don't need to save in the internal repr...
-          std::getline(mif_file, pen_line);
-
-          // The features in the region files have a brush as well as a pen...
-          if(region)
-            std::getline(mif_file, pen_line);
-
-          // If we aren't defering the read-in of the heavy-data, read the mid file (which will be a single line per feature)...
-          if(!justInTime)
-            std::getline(mid_file, mid_line);
-
-          // And finally, add the features to the internal vector of features...
-          for(auto f : fs){
-            // Split the attributes into words, store in the feature...
-            if(!justInTime)
-              f.attributes = utils::readLine(mid_line, ',');
-            features.push_back(f);
-            // We will assume that this feature matters, for now...
-            dropFeature.push_back(false);
-          }
-        }
-      }
+      // ...and keep a binary copy for the next time around.
+      if(cache && !justInTime)
+        writeBinary(binFile);
     }
 
-    // Helper function to add a new attribute to the MIF file...
-    void addAttribute(const std::string name, const std::string type = "string", const int fieldSize=254){
+
+    // Helper function to add a new attribute to the MIF file (every feature starts with the attribute missing), returning the
+    // index of the new column...
+    int addAttribute(const std::string name, const std::string type = "string", const int fieldSize=254){
+      columns.push_back(attributeDeclaration(name, type, fieldSize));
       dropColumn.push_back(false);
-      if(utils::lower_case(type) == "string"){
-        columns.push_back("  " + name + " Char(" + std::to_string(fieldSize) + ")");
-      }else if(utils::lower_case(type) == "float"){
-        columns.push_back("  " + name + " Float");
-      }
+      features.attributes.addColumn(attributeType(columns.back()));
+      return columns.size() - 1;
     }
 
     // Helper function to drop a column from the MIF file before writing...
@@ -281,7 +667,7 @@ namespace oia_risk_model{
     }
 
     // Helper function to clean the lines in a MIF file by dividing on grid / graticule lines (file on disk)...
-    void divideFeatures(const std::string asciiFile, const bool record_division=true){
+    void divideFeatures(const std::string asciiFile, const bool record_division=true, const int threads=0){
       if(!utils::exists(asciiFile))
         Exception("Ascii filedoes not seem to exist (" + asciiFile +")");
 
@@ -289,115 +675,214 @@ namespace oia_risk_model{
       Ascii ascii(asciiFile);
 
       // Call the overloaded method...
-      divideFeatures(ascii, record_division);
+      divideFeatures(ascii, record_division, threads);
     }
 
-    // Helper function to clean the lines in a MIF file by dividing on grid / graticule lines (file in memory)...
-    void divideFeatures(const Ascii ascii, const bool record_division=false){
-      // A vector of cleaned features (features with additional lines, broken by grid / graticule)...
-      std::vector<Feature> cleanedFeatures;
-      std::vector<bool>    dropCleanFeature;
-
-      // Append a new attribute to indicate the line has been divided...
-      if(record_division)
-        addAttribute("is_divided", "string", 7);
-
-
-#ifdef CHATTY
-      // Test the number of features...
-      std::cout << "Number of features BEFORE cleaning = " << features.size() << "\n";
-#endif // CHATTY
-
-      // Loop over all the features in the mif file...
-      for(auto f : features){
-        // Create a new, clean feature...
-        Feature clean;
-
-        // Give the clean feature the same attributes as the feature we are testing...
-        clean.attributes = f.attributes;
-
-        // And a flag to indicate that a feature has been divided...
-        bool divided = false;
-        // Loop over each point in the original feature geometry...
-        for(std::size_t i=0; i<f.geometry.size()-1; i++){
-          // ...and construct a line to the next point.
-          geometry::Line2<double> line(f.geometry.at(i), f.geometry.at(i+1));
-
-          // If the line starts and ends in different cells, it needs to be cleaned...
-          if(ascii.cellIndex(line.start) != ascii.cellIndex(line.end)){
-            // Recover the points of intersection of the line with the grid / graticule lines...
-            std::vector<geometry::Vec2<double>> intersections = ascii.findIntersections(line);
+    // Helper function to divide a single feature's geometry on grid / graticule lines without building any features: point(p) is
+    // called for each point of the pieces in turn, and endPiece(divided) at the end of each piece (divided says whether the piece
+    // was cut from a longer feature)...
+    template <typename P, typename E>
+    static void divideGeometry(const Ascii& ascii, const geometry::Vec2<double>* pts, const std::size_t n, P point, E endPiece){
+      // A flag to indicate that the feature has been divided...
+      bool divided = false;
+
+      // Loop over each point in the original feature geometry...
+      for(std::size_t i=0; i+1<n; i++){
+        // ...and construct a line to the next point.
+        geometry::Line2<double> line(pts[i], pts[i+1]);
+
+        // If the line starts and ends in different cells, it needs to be cleaned...
+        if(ascii.cellIndex(line.start) != ascii.cellIndex(line.end)){
+          // Add the start of the line to the current piece...
+          point(line.start);
+
+          // Walk the line across the grid: every piece after the first starts at a crossing, where a new piece begins...
+          bool first = true;
+          ascii.traverse(line, [&](int, const geometry::Vec2<double>& crossing, const geometry::Vec2<double>&, double){
+            if(first){
+              first = false;
+              return;
+            }
 
-            // Add the start of the line to the cleaned feature...
-            clean.geometry.push_back(line.start);
+            // Finish the current piece at the crossing point, and start the next one there...
+            point(crossing);
+            endPiece(true);
+            point(crossing);
+          });
 
-            // Loop over each intersection, and add a new feature for each...
-            for(std::size_t j=1; j<intersections.size(); j++){
-              // Add the crossing point to the cleaned features geometry...
-              clean.geometry.push_back(intersections.at(j));
+          // Mark the line as divided...
+          divided = true;
+        }else{
+          // ...if the line is already clean, append directly to the current piece.
+          point(pts[i]);
+        }
+      }
 
-              // Set the attributes to indicate the feature has been cleaned...
-              if(record_division)
-                clean.attributes.push_back("\"true\"");
+      // Finally, we need to append the last point in the feature geometry to the last piece.
+      if(n > 0)
+        point(pts[n-1]);
+      endPiece(divided);
+    }
 
-              // Stick the cleaned feature on the tab...
-              cleanedFeatures.push_back(clean);
-              dropCleanFeature.push_back(false);
+    // Helper function to divide a store of features on grid / graticule lines, returning the pieces. Each piece takes the attributes
+    // of the feature it came from (whose index goes in parent) and, if divisionColumn is given, "true" or "false" in that (string)
+    // column depending on whether the piece was cut from a longer feature. The features are consumed as they are divided, and
+    // left empty...
+    //   NOTE: Features are divided in parallel (threads = 0 means use all cores), but come out in their original order. Each
+    //   feature is walked twice: once to count its pieces (which allocates nothing, beyond the counts), so the pieces can be
+    //   written straight into a store reserved to the right size. They are then written DIVIDE_BLOCK features at a time,
+    //   handing back the memory each block of features took up as it goes, so the pieces and the features they came from are
+    //   never held in memory at once (i.e. peak memory is the larger of the two, rather than both).
+    static FeatureStore divide(const Ascii& ascii, FeatureStore& features, std::vector<std::size_t>& parent,
+                               const int divisionColumn=-1, const int threads=0){
+      // First, count the number of pieces and points each feature divides into...
+      std::vector<std::size_t> firstPiece(features.size() + 1, 0);
+      std::vector<std::size_t> firstPoint(features.size() + 1, 0);
+      parallel::forChunks(features.size(), threads, [&](std::size_t, std::size_t begin, std::size_t end){
+        for(std::size_t i=begin; i<end; i++)
+          divideGeometry(ascii, features.points(i), features.numPoints(i),
+                         [&](const geometry::Vec2<double>&){ firstPoint[i+1]++; },
+                         [&](bool){ firstPiece[i+1]++; });
+      });
+
+      // ...which gives the position of each feature's first piece and point in the cleaned store.
+      std::partial_sum(firstPiece.begin(), firstPiece.end(), firstPiece.begin());
+      std::partial_sum(firstPoint.begin(), firstPoint.end(), firstPoint.begin());
+
+      // Making room for the pieces doesn't take up any memory until they are written...
+      FeatureStore cleaned;
+      cleaned.attributes = features.attributes.schema();
+      cleaned.reserve(firstPiece.back(), firstPoint.back());
+      parent.clear();
+      parent.reserve(firstPiece.back());
+
+      // The division flag only ever takes one of two values...
+      std::uint32_t isDivided = 0, notDivided = 0;
+      if(divisionColumn >= 0){
+        isDivided  = cleaned.attributes[divisionColumn].encode("\"true\"");
+        notDivided = cleaned.attributes[divisionColumn].encode("\"false\"");
+      }
 
-              // Reset the clean feature ready to process the rest of the geometry...
-              clean.attributes.clear();
-              clean.attributes = f.attributes;
-              clean.geometry.clear();
+      // Then work through the features a block at a time...
+      for(std::size_t block=0; block<features.size(); block+=DIVIDE_BLOCK){
+        const std::size_t blockEnd = std::min(features.size(), block + DIVIDE_BLOCK);
+        cleaned.resize(firstPiece[blockEnd], firstPoint[blockEnd]);
+        parent.resize(firstPiece[blockEnd]);
+
+        // ...dividing each feature again, and writing the pieces into place...
+        parallel::forChunks(blockEnd - block, threads, [&](std::size_t, std::size_t begin, std::size_t end){
+          for(std::size_t i=block+begin; i<block+end; i++){
+            std::size_t piece = firstPiece[i];
+            std::size_t point = firstPoint[i];
+            divideGeometry(ascii, features.points(i), features.numPoints(i),
+                           [&](const geometry::Vec2<double>& p){ cleaned.coords[point++] = p; },
+                           [&](bool divided){
+                             // Close off the piece, giving it the attributes of the original feature...
+                             cleaned.offsets[piece+1] = point;
+                             cleaned.attributes.copyRow(features.attributes, i, piece);
+                             parent[piece] = i;
+
+                             // ...and a bonus attribute indicating whether the feature was divided or not.
+                             if(divisionColumn >= 0)
+                               cleaned.attributes[divisionColumn].codes[piece] = divided ? isDivided : notDivided;
+                             piece++;
+                           });
+          }
+        });
 
-              // And add the start point of the line...
-              clean.geometry.push_back(intersections.at(j));
-            }
+        // ...giving each piece a BB, now they are all in place...
+        parallel::forChunks(firstPiece[blockEnd] - firstPiece[block], threads, [&](std::size_t, std::size_t begin, std::size_t end){
+          for(std::size_t i=firstPiece[block]+begin; i<firstPiece[block]+end; i++)
+            if(cleaned.numPoints(i) > 0)
+              cleaned.addBB(i);
+        });
 
-            // Mark the line as divided...
-            divided = true;
-          }else{
-            // ...if the line is already clean, append directly to the cleaned features geometry.
-          clean.geometry.push_back(f.geometry.at(i));
-          }
-        }
+        // ...and then handing back the memory the features took up.
+        features.release(block, blockEnd);
+      }
 
-        // Finally, we need to append the last point in the feature geometry to the newly cleaned geometry.
-        clean.geometry.push_back(f.geometry.at(f.geometry.size()-1));
+      // Nothing is left of the features...
+      features = FeatureStore();
+      return cleaned;
+    }
 
-        // Grab the attributes of the original feature...
-        clean.attributes = f.attributes;
+    // Helper function to clean the lines in a MIF file by dividing on grid / graticule lines (file in memory, see divide)...
+    void divideFeatures(const Ascii& ascii, const bool record_division=false, const int threads=0){
+      // Append a new attribute to indicate the line has been divided...
+      if(record_division)
+        addAttribute("is_divided", "string", 7);
 
-        // And a bonus attrbute indicating whether the feature was divided or not.
-        if(record_division)
-          clean.attributes.push_back( divided ? "\"true\"" : "\"false\"");
 
-        // ...and stick it all on the tab.
-        cleanedFeatures.push_back(clean);
-        dropCleanFeature.push_back(false);
-      }
+#ifdef CHATTY
+      // Test the number of features...
+      std::cout << "Number of features BEFORE cleaning = " << features.size() << "\n";
+#endif // CHATTY
 
-      // Finally, delete the original features and drop indicators...
-      features.clear();
-      dropFeature.clear();
+      // Replace the original features with the cleaned ones...
+      std::vector<std::size_t> parent;
+      features = divide(ascii, features, parent, record_division ? int(columns.size()) - 1 : -1, threads);
 
-      // ...and add the new features / indicators in their place.
-      features = cleanedFeatures;
-      dropFeature = dropCleanFeature;
+      // ...whose attributes are on the same line of the .mid as the feature they came from...
+      for(auto& p : parent)
+        p = midLine[p];
+      midLine = std::move(parent);
 
-      // Finally, add the BB to the line features...
-      for(auto& f : features)
-        f.addBB();
+      // ...and none of which are being dropped.
+      dropFeature.assign(features.size(), false);
 
 #ifdef CHATTY
       std::cout << "Number of features AFTER cleaning = " << features.size() << "\n";
 #endif // CHATTY
     }
 
+    // Helper function to label a threshold in a column name, as the shortest fixed-point form of the value with any "-" written
+    // as "m" and "." as "p", so that the name is valid in MapInfo (e.g. 0.5 is 0p5, -1 is m1, and 1e-07 is 0p0000001)...
+    static std::string thresholdLabel(const double threshold){
+      char buffer[400];
+      std::string label(buffer, std::to_chars(buffer, buffer + sizeof(buffer), threshold, std::chars_format::fixed).ptr);
+      std::replace(label.begin(), label.end(), '-', 'm');
+      std::replace(label.begin(), label.end(), '.', 'p');
+      return label;
+    }
+
+    // Helper function to add the exposure of each (undivided) feature to a raster as new attributes, walking each feature across
+    // the grid once rather than dividing it and sampling the pieces. Adds Float attributes <name>_max, <name>_mean and, for each
+    // threshold, <name>_km_above_<threshold> (labelled by thresholdLabel)...
+    //   cellLengths: if given, filled with the length of each feature in each cell it passes through, in feature order.
+    void addExposureStatistics(const Ascii& ascii, const std::string name, const std::vector<double> thresholds=std::vector<double>(),
+                               std::vector<CellLength>* cellLengths=nullptr, const int threads=0){
+      // Add the new attributes...
+      const int maxColumn  = addAttribute(name + "_max", "Float");
+      const int meanColumn = addAttribute(name + "_mean", "Float");
+      for(auto t : thresholds)
+        addAttribute(name + "_km_above_" + thresholdLabel(t), "Float");
+
+      // Each thread looks after a contiguous chunk of the features (and keeps its own record of the cells they pass through)...
+      std::vector<std::vector<CellLength>> chunks(parallel::numThreads(threads));
+      parallel::forChunks(features.size(), chunks.size(), [&](std::size_t c, std::size_t begin, std::size_t end){
+        for(std::size_t i=begin; i<end; i++){
+          ExposureStatistics stats = exposureStatistics(ascii, features.points(i), features.numPoints(i), thresholds, i,
+                                                        cellLengths ? &chunks[c] : nullptr);
+
+          // Stick the statistics on the tab (the threshold columns follow the mean)...
+          features.attributes[maxColumn].setNumber(i, stats.maxDepth);
+          features.attributes[meanColumn].setNumber(i, stats.meanDepth);
+          for(std::size_t t=0; t<stats.lengthAbove.size(); t++)
+            features.attributes[meanColumn + 1 + t].setNumber(i, stats.lengthAbove[t]);
+        }
+      });
+
+      // Gather up the lengths in each cell, in feature order...
+      if(cellLengths)
+        for(auto& chunk : chunks)
+          cellLengths->insert(cellLengths->end(), chunk.begin(), chunk.end());
+    }
+
     // Helper function to densify the lines in MIF Regions files by dividing wherever they cross grid / graticule lines...
     void densifyRegions(const std::string asciiFile){
-      // A vector of densified features (features with additional lines, broken by grid / graticule)...
-      std::vector<Feature> densifiedFeatures;
-      std::vector<bool>    dropDensifiedFeature;
+      // A store of densified features (features with additional lines, broken by grid / graticule)...
+      FeatureStore densified;
+      densified.reserve(features.size(), features.coords.size());
 
       // Read the incoming raster...
       Ascii ascii(asciiFile);
@@ -406,182 +891,154 @@ namespace oia_risk_model{
       std::cout << "Number of features BEFORE cleaning = " << features.size() << "\n";
 #endif // CHATTY
 
+      // Somewhere to build the new geometry of each feature...
+      std::vector<geometry::Vec2<double>> divided;
+
       // Loop over all the features in the mif file...
-      for(auto f : features){
-        // We will replace the old feature with a new one, with more points in the geometry...
-        Feature divided;
+      for(std::size_t iF=0; iF<features.size(); iF++){
+        const geometry::Vec2<double>* pts = features.points(iF);
+        const std::size_t             n   = features.numPoints(iF);
 
-        // Give the clean feature the same attributes as old one it will replace...
-        divided.attributes = f.attributes;
+        // We will replace the old feature with a new one, with more points in the geometry...
+        divided.clear();
 
         // Loop over each point in the original feature geometry...
-        for(std::size_t i=0; i<f.geometry.size()-1; i++){
+        for(std::size_t i=0; i+1<n; i++){
           // ...and construct a line to the next point.
-          geometry::Line2<double> line(f.geometry.at(i), f.geometry.at(i+1));
+          geometry::Line2<double> line(pts[i], pts[i+1]);
 
           // If the line starts and ends in different cells, it needs to be cleaned...
           if(ascii.cellIndex(line.start) != ascii.cellIndex(line.end)){
-            // Recover the points of intersection of the line with the grid / graticule lines...
-            std::vector<geometry::Vec2<double>> intersections = ascii.findIntersections(line);
-
-            // Add the start of the line to the cleaned feature...
-            divided.geometry.push_back(line.start);
-
-            // Loop over each intersection, and add a new feature for each...
-            for(std::size_t j=1; j<intersections.size(); j++){
-              // Add the crossing point to the cleaned features geometry...
-              divided.geometry.push_back(intersections.at(j));
-            }
+            // Walk the line across the grid, adding the start of the line and then each crossing point to the geometry...
+            ascii.traverse(line, [&](int, const geometry::Vec2<double>& entry, const geometry::Vec2<double>&, double){
+              divided.push_back(entry);
+            });
           }else{
             // ...if the line is already clean, append directly to the cleaned features geometry.
-          divided.geometry.push_back(f.geometry.at(i));
+          divided.push_back(pts[i]);
           }
         }
 
         // Finally, we need to append the last point in the feature geometry to the newly cleaned geometry.
-        divided.geometry.push_back(f.geometry.at(f.geometry.size()-1));
-
-        // Grab the attributes of the original feature...
-        divided.attributes = f.attributes;
+        divided.push_back(pts[n-1]);
 
         // ...and stick it all on the tab.
-        densifiedFeatures.push_back(divided);
-        dropDensifiedFeature.push_back(false);
+        densified.append(divided.data(), divided.size());
       }
 
-      // Finally, delete the original features...
-      features.clear();
-      dropFeature.clear();
-
-      // ...and add the new features in their place.
-      features    = densifiedFeatures;
-      dropFeature = dropDensifiedFeature;
+      // Finally, replace the original features with the new ones (which keep the original attributes).
+      densified.attributes = std::move(features.attributes);
+      features = std::move(densified);
+      dropFeature.assign(features.size(), false);
 
 #ifdef CHATTY
       std::cout << "Number of features AFTER cleaning = " << features.size() << "\n";
 #endif // CHATTY
     }
 
-    // Helper function to write the MID file to disk...
-    void writeMID(const std::string fileName, const std::string merge="NONE") const {
+    // Helper function to write the MID file to disk, merging the Float attributes of any dropped features into the feature
+    // before them ("SUM", "MIN", "MAX" or "MEAN"). Chunks of features are formatted in parallel, and written out in order...
+    void writeMID(const std::string fileName, const std::string merge="NONE", const int threads=0) const {
       // Open the output file...
       std::ofstream outFile;
       outFile.open(fileName + ".mid");
-
-      // Has processing the MID file been defered?
-      std::vector<std::string> midLines;
-      if(justInTime){
-        std::ifstream           inFile;
-        inFile.open(_fileName + ".mid");
-
-        std::string line;
-
-        while(!inFile.eof()){
-          std::getline(inFile, line);
-          if(line.size() > 0){
-            midLines.push_back(line);
-          }
-        }
-
-#ifdef CHATTY
-        std::cout << "Size of mid file vector = " << midLines.size() << "\n";
-#endif
-
-        inFile.close();
-      }
-
-      // Loop over each feature...
-      std::size_t iF=0;
-      while(iF < features.size()){
-        // Is this a feature that is being dropped?
-        if(dropFeature.at(iF))
-          continue;
-
-        // Copy the first features attributes...
-        std::vector<std::string> merged_attributes;
-
-        // Get the attributes for the feature...
-        if(justInTime){
-          merged_attributes = utils::readLine(midLines.at(iF));
-        }else{
-          merged_attributes = features.at(iF).attributes;
-        }
-
-        std::size_t iFF = iF + 1;
-        double numMerged = 1;
-        while(iFF < features.size() && dropFeature.at(iFF)){
-          std::vector<std::string> next_attributes;
-
-          // Are we doing this JIT or from memory?
-          if(justInTime){
-            next_attributes = utils::readLine(midLines.at(iFF));
-          }else{
-            next_attributes = features.at(iFF).attributes;
-          }
-
-          for(std::size_t iA=0; iA<merged_attributes.size(); iA++){
-            // For floats, we want to operate on the attribute data...
-            if(columns.at(iA).find("Float") != std::string::npos){
-              // Does this column contain a probability?
-              bool prob = (columns.at(iA).find("annualProbability") != std::string::npos);
-
-              // Recover the existing value and the equivalent from the merged feature...
-              double existing = std::stod(merged_attributes.at(iA));
-              double incoming = std::stod(next_attributes.at(iA));
-
-              // And then do stuff...
-              if(merge == "SUM" || merge == "MEAN"){
-                // We can't just sum up probailities...
-                if(!prob){
-                  merged_attributes.at(iA) = std::to_string(existing + incoming);
-                }else{
-                  double p = existing + ((1 - existing) * incoming);
-                  merged_attributes.at(iA) = std::to_string(p);
+      if(!outFile)
+        Exception("Unable to create MID file (" + fileName + ".mid)");
+
+      // Does each column contain a probability?
+      std::vector<bool> prob(columns.size());
+      for(std::size_t iA=0; iA<columns.size(); iA++)
+        prob[iA] = columns.at(iA).find("annualProbability") != std::string::npos;
+
+      // Loop over the features a block at a time (reading their attributes from the .mid if that has been defered)...
+      forAttributeBlocks([&](const AttributeTable& table, const std::size_t first, const std::size_t begin, const std::size_t end){
+        parallel::forOrderedChunks(end - begin, threads, WRITE_CHUNK, [&](std::size_t cBegin, std::size_t cEnd, std::string& text){
+          // Somewhere to merge the Float attributes of neighbouring features...
+          std::vector<double> merged(table.numColumns());
+
+          for(std::size_t iF=begin+cBegin; iF<begin+cEnd; iF++){
+            // Is this a feature that is being dropped (in which case it has been merged into an earlier one)?
+            if(dropFeature.at(iF))
+              continue;
+
+            // Copy the first features attributes...
+            for(std::size_t iA=0; iA<table.numColumns(); iA++)
+              if(table[iA].type == FLOAT)
+                merged[iA] = table[iA].floats[iF - first];
+
+            std::size_t iFF = iF + 1;
+            double numMerged = 1;
+            while(iFF < end && dropFeature.at(iFF)){
+              for(std::size_t iA=0; iA<table.numColumns(); iA++){
+                // For floats, we want to operate on the attribute data...
+                if(table[iA].type == FLOAT){
+                  // Recover the existing value and the equivalent from the merged feature...
+                  double& existing = merged[iA];
+                  double  incoming = table[iA].floats[iFF - first];
+
+                  // And then do stuff...
+                  if(merge == "SUM" || merge == "MEAN"){
+                    // We can't just sum up probailities...
+                    if(!prob[iA])
+                      existing = existing + incoming;
+                    else
+                      existing = existing + ((1 - existing) * incoming);
+                  }else if(merge == "MIN"){
+                    existing = std::min(existing, incoming);
+                  }else if(merge == "MAX"){
+                    existing = std::max(existing, incoming);
+                  }
                 }
-              }else if(merge == "MIN"){
-                merged_attributes.at(iA) = std::to_string(std::min(existing, incoming));
-              }else if(merge == "MAX"){
-                merged_attributes.at(iA) = std::to_string(std::max(existing, incoming));
               }
+              // Increase the number of merged features...
+              numMerged++;
+              // Increate the counter...
+              iFF++;
             }
-          }
-          // Increase the number of merged features...
-          numMerged++;
-          // Increate the counter...
-          iFF++;
-        }
 
-        // If the attributes are being averaged, then do this now...
-        if(merge == "MEAN"){
-          for(auto& a : merged_attributes){
-              double existing = std::stod(a);
-              a = std::to_string(existing / numMerged);
-          }
-        }
-
-        // FINALLY write the data to disk...
-        for(std::size_t iA=0; iA<merged_attributes.size()-1; iA++){
-          if(!dropColumn.at(iA)){
-            auto a = merged_attributes.at(iA);
-            outFile  << a << ",";
+            // If the attributes are being averaged, then do this now...
+            if(merge == "MEAN")
+              for(std::size_t iA=0; iA<table.numColumns(); iA++)
+                if(table[iA].type == FLOAT)
+                  merged[iA] /= numMerged;
+
+            // FINALLY format the data (the merged Floats, and everything else from the first feature)...
+            bool firstColumn = true;
+            for(std::size_t iA=0; iA<table.numColumns(); iA++){
+              if(dropColumn.at(iA))
+                continue;
+              if(!firstColumn)
+                text += ',';
+              firstColumn = false;
+              if(table[iA].type == FLOAT)
+                AttributeColumn::formatFloat(merged[iA], text);
+              else
+                table[iA].format(iF - first, text);
+            }
+            text += '\n';
           }
-        }
-
-        if(!dropColumn.at(merged_attributes.size()-1))
-          outFile << merged_attributes.at(merged_attributes.size()-1) << "\n";
-        else
-          outFile << "\n";
-
-        iF = iFF;
-      }
+        }, [&](const std::string& text){
+          outFile.write(text.data(), text.size());
+        });
+      });
 
       outFile.close();
     }
 
-    // Helper function to write the MIF file to disk...
-    void write(const std::string fileName, const bool justMif=false) const {
+    // Helper function to append a point to the text of a .mif (to 13 significant figures)...
+    static void appendPoint(std::string& text, const geometry::Vec2<double>& p){
+      utils::appendNumber(text, p.x, 13);
+      text += ' ';
+      utils::appendNumber(text, p.y, 13);
+      text += '\n';
+    }
+
+    // Helper function to write the MIF file to disk. Chunks of features are formatted in parallel, and written out in order...
+    void write(const std::string fileName, const bool justMif=false, const int threads=0) const {
       std::ofstream outFile;
       outFile.open(fileName + ".mif");
+      if(!outFile)
+        Exception("Unable to create MIF file (" + fileName + ".mif)");
 
       // First, write the header...
       for(auto line : header){
@@ -604,121 +1061,111 @@ namespace oia_risk_model{
       outFile << "\n";
 
       // Loop over each of the features...
-      std::size_t iF = 0;
-      while(iF < features.size()){
-        // Grab the feature...
-        auto f = features.at(iF);
-
-        // If this is not a dropped feature, Write the region or pline descriptor...
-        if(!dropFeature.at(iF)){
-          if(region)
-            outFile << "Region 1\n";
-          else
-            outFile << "Pline ";
-
-          // We need to calculate the number of points in the geometry, which needs to be calculated...
-          int numPoints = f.geometry.size();
+      parallel::forOrderedChunks(features.size(), threads, WRITE_CHUNK, [&](std::size_t begin, std::size_t end, std::string& text){
+        for(std::size_t iF=begin; iF<end; iF++){
+          // If this is not a dropped feature, Write the region or pline descriptor...
+          if(!dropFeature.at(iF)){
+            text += region ? "Region 1\n" : "Pline ";
+
+            // We need to calculate the number of points in the geometry, which needs to be calculated...
+            int numPoints = features.numPoints(iF);
+
+            // Get the index of the next feature...
+            std::size_t iFF = iF + 1;
+            while(iFF < features.size() && dropFeature.at(iFF)){
+              numPoints += features.numPoints(iFF) - (features.last(iFF-1) == features.first(iFF) && dropFeature.at(iFF));
+              iFF++;
+            }
 
-          // Get the index of the next feature...
-          std::size_t iFF = iF + 1;
-          while(iFF < features.size() && dropFeature.at(iFF)){
-            numPoints += features.at(iFF).geometry.size() - (features.at(iFF-1).geometry.at(features.at(iFF-1).geometry.size()-1) == features.at(iFF).geometry.at(0) && dropFeature.at(iFF));
-            iFF++;
+            utils::appendInteger(text, numPoints);
+            text += '\n';
           }
 
-          outFile << numPoints << "\n";
-        }
-
-        // Write the first point in the geometry if needed...
-        if(!dropFeature.at(iF) || !(f.geometry.at(0) == features.at(iF-1).geometry.at(features.at(iF-1).geometry.size()-1) && dropFeature.at(iF)))
-          outFile << std::setprecision(13) << f.geometry.at(0).x << " " << f.geometry.at(0).y << "\n";
-
-        // Write the rest of the features...
-        for(std::size_t iP=1; iP<f.geometry.size(); iP++)
-          outFile << std::setprecision(13) << f.geometry.at(iP).x << " " << f.geometry.at(iP).y << "\n";
-
-        // If this is NOT the last feature, we want to test if the next feature is being dropped...
-        if(iF < features.size()-1){
-          // Are we dropping the next feature?
-          if(!dropFeature.at(iF+1)){
-            // If not, we can close out the repr with the pen and brush (if needed)...
-            outFile << "    Pen (1,2,0)\n";
-            if(region)
-                outFile << "    Brush (1,0,16777215)\n";
+          // Write the first point in the geometry if needed...
+          const geometry::Vec2<double>* pts = features.points(iF);
+          if(features.numPoints(iF) > 0 && (!dropFeature.at(iF) || !(iF > 0 && features.first(iF) == features.last(iF-1))))
+            appendPoint(text, pts[0]);
+
+          // Write the rest of the features...
+          for(std::size_t iP=1; iP<features.numPoints(iF); iP++)
+            appendPoint(text, pts[iP]);
+
+          // If this is NOT the last feature, we want to test if the next feature is being dropped...
+          if(iF < features.size()-1){
+            // Are we dropping the next feature?
+            if(!dropFeature.at(iF+1)){
+              // If not, we can close out the repr with the pen and brush (if needed)...
+              text += "    Pen (1,2,0)\n";
+              if(region)
+                text += "    Brush (1,0,16777215)\n";
+            }
           }
         }
-
-        // Mosy on over to the first feature that is different to this one...
-        iF++;
-      }
+      }, [&](const std::string& text){
+        outFile.write(text.data(), text.size());
+      });
 
       outFile.close();
 
       // Write tne MID file...
       if(!justMif)
-        writeMID(fileName);
+        writeMID(fileName, "NONE", threads);
     }
 
-    // Write a MIf file to disk from buffered files, rather than feature attributes...
-    void writefromBuffer(const std::string fileName, const std::vector<std::string> buffers){
+    // Write a MIF file to disk with extra Float attributes held in a scratch matrix (a column per attribute, a row per feature),
+    // rather than in the feature attributes. Rows are transposed out of the matrix a chunk at a time, and chunks of features
+    // are formatted in parallel and written out in order...
+    void writefromBuffer(const std::string fileName, const utils::ScratchMatrix& buffer, const std::vector<std::string> names,
+                         const int threads=0){
+      if(buffer.numRows != features.size() || buffer.numColumns != names.size())
+        Exception("The buffered attributes do not match the features (" + std::to_string(buffer.numRows) + " x " +
+                  std::to_string(buffer.numColumns) + " for " + std::to_string(features.size()) + " features and " +
+                  std::to_string(names.size()) + " attributes)");
+
       // Open the mid file for output...
       std::ofstream midFile;
       midFile.open(fileName + ".mid");
-
-      // Create some ifstreams to use to read the files...
-      std::vector<std::ifstream*> files;
-
-      // Open each of the buffers in turn...
-      for(auto buffer : buffers){
-        std::ifstream* f = new std::ifstream(buffer, std::ios::in | std::ios::binary);
-        files.push_back(f);
-      }
-
-      // Create some storage for the buffered data...
-      std::vector<double> data;
-      data.resize(buffers.size(), 0);
-
-      // Loop over each feature...
-      for(auto f : features){
-        // Read the data from file...
-        int iFile=0;
-        for(auto f : files){
-          // Read the next record...
-          f->read((char*)&data.at(iFile), sizeof(double));
-          // Increment the file...
-          iFile++;
-        }
-
-        // First, add the attributes stored "properly"...
-        for(auto a : f.attributes)
-          midFile  << a << ",";
-
-        // Followed by the data just read from disk...
-        for(std::size_t i=0; i<data.size()-1; i++)
-          midFile << data.at(i) << ",";
-
-        // Finally, write the last vale to disk, and add a newline...
-        midFile << data.at(data.size()-1) << "\n";
-
-      }
+      if(!midFile)
+        Exception("Unable to create MID file (" + fileName + ".mid)");
+
+      // Loop over the features a block at a time (reading their attributes from the .mid if that has been defered)...
+      forAttributeBlocks([&](const AttributeTable& table, const std::size_t first, const std::size_t begin, const std::size_t end){
+        parallel::forOrderedChunks(end - begin, threads, WRITE_CHUNK, [&](std::size_t cBegin, std::size_t cEnd, std::string& text){
+          // Somewhere to transpose the buffered data for a few features at a time...
+          std::vector<double> data(utils::ScratchMatrix::TILE*buffer.numColumns);
+
+          for(std::size_t t0=begin+cBegin; t0<begin+cEnd; t0+=utils::ScratchMatrix::TILE){
+            const std::size_t t1 = std::min(begin + cEnd, t0 + utils::ScratchMatrix::TILE);
+            buffer.rows(t0, t1, data.data());
+
+            for(std::size_t iF=t0; iF<t1; iF++){
+              // First, add the attributes stored "properly"...
+              table.formatRow(iF - first, text);
+
+              // Followed by the buffered data...
+              const double* values = &data[(iF - t0)*buffer.numColumns];
+              for(std::size_t i=0; i<buffer.numColumns; i++){
+                if(i > 0 || table.numColumns() > 0)
+                  text += ',';
+                utils::appendNumber(text, values[i]);
+              }
+              text += '\n';
+            }
+          }
+        }, [&](const std::string& text){
+          midFile.write(text.data(), text.size());
+        });
+      });
 
       // And close out the midFile...
       midFile.close();
 
-      // Close each of the buffers...
-      for(auto& f : files)
-        f->close();
-
-      // ...and delete!
-      for(auto b : buffers)
-        remove(b.c_str());
-
-      // Finally, we need to add the buffers to the MIF file itself...
-      for(auto buffer : buffers)
-        addAttribute(buffer, "Float");
+      // Finally, we need to add the buffered attributes to the MIF file itself...
+      for(auto name : names)
+        addAttribute(name, "Float");
 
       // And write it out (without the MID)...
-      write(fileName, true);
+      write(fileName, true, threads);
     }
   };
 
@@ -736,8 +1183,10 @@ namespace oia_risk_model{
     inFile2.open(mid2);
 
     // Create somewhere to read the data...
-    std::string line1;
-    std::string line2;
+    std::string                   line1;
+    std::string                   line2;
+    std::vector<std::string_view> words1;
+    std::vector<std::string_view> words2;
 
     while(!inFile1.eof()){
       std::getline(inFile1,line1);
@@ -745,8 +1194,8 @@ namespace oia_risk_model{
 
       if(line1.size() > 0){
         // Parse the words...
-        std::vector<std::string> words1 = utils::readLine(line1);
-        std::vector<std::string> words2 = utils::readLine(line2);
+        utils::splitLine(line1, ',', words1);
+        utils::splitLine(line2, ',', words2);
 
         // Write the data from the first mid...
         for(auto word : words1){
@@ -780,35 +1229,11 @@ namespace oia_risk_model{
     // Read the file...
     MIF mif(mifFile);
 
-    // Are we doing this JIT, or from memory?
-    if(mif.justInTime){
-      // Open and read the MIF to find the ids of the features...
-      std::ifstream inFile;
-      inFile.open(mif._fileName + ".mid");
-
-      std::string line;
-
-      std::vector<std::string> id;
-
-      while(!inFile.eof()){
-        std::getline(inFile, line);
-        std::vector<std::string> words = utils::readLine(line, ',');
-        id.push_back(words.at(id_col));
-      }
-
-      inFile.close();
-
-      // Loop over all the features, looking for neighbours that have been split...
-      for(std::size_t i=1; i<mif.features.size(); i++)
-        if(id.at(i) == id.at(i-1))
-          mif.dropFeature.at(i) = true;
-
-    }else{
-      // We have the data in memory, so can find the features that have been divided simply...
-      for(std::size_t i=1; i<mif.features.size(); i++)
-        if(mif.features.at(i).attributes.at(id_col) == mif.features.at(i-1).attributes.at(id_col))
-          mif.dropFeature.at(i) = true;
-    }
+    // We have the data in memory, so can find the features that have been divided simply...
+    const AttributeColumn& id = mif.features.attributes.columns.at(id_col);
+    for(std::size_t i=1; i<mif.features.size(); i++)
+      if(id.equal(i, i-1))
+        mif.dropFeature.at(i) = true;
 
     // By this point, we have identidied the features to merge back together again - we can write the
     // file, being clear what we want to do to the merged attributes features.
@@ -824,36 +1249,19 @@ namespace oia_risk_model{
     // which operate on Float attributes only:
     // "SUM", "MIN", "MAX" and "MEAN"
 
-    // Are we doing this JIT, or from memory?
-    if(mif.justInTime){
-      // Open and read the MIF to find the ids of the features...
-      std::ifstream inFile;
-      inFile.open(mif._fileName + ".mid");
-
-      std::vector<std::string> id;
-
-      while(!inFile.eof()){
-        std::string line;
-        std::getline(inFile, line);
-
-        std::vector<std::string> words = utils::readLine(line, ',');
-
-        if(words.size() > id_col)
-          id.push_back(words.at(id_col));
-      }
-
-      inFile.close();
-
-      // Loop over all the features, looking for neighbours that have been split...
-      for(std::size_t i=1; i<mif.features.size(); i++)
-        if(id.at(i) == id.at(i-1))
-          mif.dropFeature.at(i) = true;
-    }else{
-      // We have the data in memory, so can find the features that have been divided simply...
-      for(std::size_t i=1; i<mif.features.size(); i++)
-        if(mif.features.at(i).attributes.at(id_col) == mif.features.at(i-1).attributes.at(id_col))
+    // Loop over all the features, looking for neighbours that have been split (a block at a time, so the attributes can be read
+    // from the .mid if that has been defered)...
+    std::string previous;
+    mif.forAttributeBlocks([&](const AttributeTable& table, const std::size_t first, const std::size_t begin, const std::size_t end){
+      const AttributeColumn& id = table.columns.at(id_col);
+      for(std::size_t i=std::max(begin, std::size_t(1)); i<end; i++)
+        if(i > begin ? id.equal(i - first, i - 1 - first) : id.text(i - first) == previous)
           mif.dropFeature.at(i) = true;
-    }
+
+      // The first feature of the next block is compared with the last of this one...
+      if(end > begin)
+        previous = id.text(end - 1 - first);
+    });
 
     // By this point, we have identidied the features to merge back together again - we can write the
     // file, being clear what we want to do to the merged attributes features.
@@ -863,339 +1271,535 @@ namespace oia_risk_model{
     return;
   }
 
-  // Helper function to addfragility to a MIF file (by default, throwing out any assets with 0 risk)...
-  void addRoadFragility(MIF mif,
-                        const fragility::FragilityCurve f,
-                        const fragility::CostFunction cf,
-                        const std::string outFile,
-                        const bool removeNoRiskAssets=true){
-    // First, we want to know which of our input columns are numeric, and need pFail calculated...
-    std::vector<bool> isRP;
-
-    // And we want to keep track of which ones belong together...
-    std::vector<std::pair<std::string,int>> scenarios;
-
-    // For the roads, there is a highway index but not for the rails or the electricity grid...
-    int highway_index    = -9;
-    int length_index     = -9;
-    int mean_speed_index = -9;
-    int tree_cover_index = -9;
-
-    // First go around, lets find the indices of interest...
-    for(std::size_t i=0; i<mif.columns.size(); i++){
-      // We also need to keep track of the highway tag on the roads - this is not part of the above calcs....
-      if(mif.columns.at(i).find("highway") != std::string::npos){
-        highway_index = i;
-      }
+  // Plan for adding road fragility and risk to a set of attributes, worked out once from the declaration of their columns. Four
+  // values follow each return-period (RP) column (pFail, eventDamage, minEventCost and maxEventCost), and four more are added for
+  // each scenario at the end (annualProbability, EAL, minEAD and maxEAD). The curve of each scenario (pFail against annual
+  // probability, 1/RP) is laid out up front too, so the risk of each asset is just a gather, interpolate and integrate...
+  struct RoadFragility{
+    fragility::FragilityCurve               f;                      // Fragility curve of the assets
+    fragility::CostFunction                 cf;                     // Costs of the assets
+    std::vector<bool>                       isRP;                   // Does each column hold the load at a return period?
+    std::vector<std::pair<std::string,int>> scenarios;              // Scenario and RP of each column ("None" and -9 if not an RP)
+    std::vector<std::string>                uniqueScenarios;        // Each scenario, in the order they are first seen
+    int                                     highway_index    = -9;  // Column of the highway tag (roads only)
+    int                                     length_index     = -9;  // Column of the length of the asset
+    int                                     mean_speed_index = -9;  // Column of the mean 10m windspeed (wind risk only)
+    int                                     tree_cover_index = -9;  // Column of the tree-cover percentage (wind risk only)
+    bool                                    windRisk = false;       // Is the risk from wind (rather than flooding)?
+    int                                     numRPCols = 0;          // Number of RP columns
+
+    // The points on the annual probability curve of a scenario, in order of increasing annual probability...
+    struct ScenarioCurve{
+      std::vector<std::size_t> rps;  // Which of the RP columns (counting RP columns only) gives each point
+      std::vector<double>      X;    // Annual probability (1/RP) of each point
+    };
+    std::vector<int>           rpColumns;  // Column of each RP
+    std::vector<ScenarioCurve> curves;     // Curve of each of the unique scenarios
+
+    // Somewhere to work out the risk of a batch of assets (kept by the caller, so nothing is allocated once it has warmed up)...
+    struct Workspace{
+      std::vector<int>           CG;       // CG of each asset
+      std::vector<double>        length;   // Length of each asset
+      std::vector<double>        minCost;  // Minimum cost of each asset
+      std::vector<double>        maxCost;  // Maximum cost of each asset
+      std::vector<double>        loads;    // Load of each asset at each RP (an RP at a time)
+      std::vector<double>        pFail;    // pFail of each asset at each RP (an RP at a time)
+      std::vector<double>        area;     // Annual probability of failure of each asset in a scenario
+      std::vector<const double*> points;   // pFail of each asset at each point on the curve of a scenario
+    };
+
+    // The CG and costs of each type of asset in a table (by dictionary code, when the types are strings)...
+    struct AssetTypes{
+      const AttributeColumn* column;   // Column holding the type of each asset
+      std::vector<int>       CG;       // CG of each type
+      std::vector<double>    minCost;  // Minimum cost of each type
+      std::vector<double>    maxCost;  // Maximum cost of each type
+    };
+
+    RoadFragility(const std::vector<std::string>& columns, const fragility::FragilityCurve f, const fragility::CostFunction cf)
+      : f(f), cf(cf){
+      // First go around, lets find the indices of interest...
+      for(std::size_t i=0; i<columns.size(); i++){
+        // We also need to keep track of the highway tag on the roads - this is not part of the above calcs....
+        if(columns.at(i).find("highway") != std::string::npos){
+          highway_index = i;
+        }
 
-      // For risk calcs, we need to keep track of the length of the asset....
-      if(mif.columns.at(i).find("feature_length_km") != std::string::npos){
-        length_index = i;
-      }
+        // For risk calcs, we need to keep track of the length of the asset....
+        if(columns.at(i).find("feature_length_km") != std::string::npos){
+          length_index = i;
+        }
 
-      // For wind-risk, we need the tree-cover percentage...
-      if(mif.columns.at(i).find("tree_cover_percent") != std::string::npos){
-        tree_cover_index = i;
-      }
+        // For wind-risk, we need the tree-cover percentage...
+        if(columns.at(i).find("tree_cover_percent") != std::string::npos){
+          tree_cover_index = i;
+        }
 
-      // ...and the mean 10m windspeed.
-      if(mif.columns.at(i).find("mean_wind_speed_10m") != std::string::npos){
-        mean_speed_index = i;
+        // ...and the mean 10m windspeed.
+        if(columns.at(i).find("mean_wind_speed_10m") != std::string::npos){
+          mean_speed_index = i;
+        }
       }
-    }
 
-    // Is the incoming file meant to provide wind risk?
-    bool windRisk = mean_speed_index > 0 && tree_cover_index > 0;
+      // Is the incoming file meant to provide wind risk?
+      windRisk = mean_speed_index > 0 && tree_cover_index > 0;
 
 #ifdef CHATTY
-    if(windRisk)
-      std::cout << "Handling wind risk...\n";
+      if(windRisk)
+        std::cout << "Handling wind risk...\n";
 #endif // CHATTY
 
-    // We want to know how many pFail columns we are adding...
-    int numRPCols = 0;
+      //...second go around, lets find the scenario and RP of each column...
+      for(std::size_t i=0; i<columns.size(); i++){
+        if(columns.at(i).find("RP") != std::string::npos){
+          isRP.push_back(true);
+          numRPCols++;
+
+          // Now we can try to identify the scenario and rp of the load...
+          std::vector<std::string_view> words;
+          utils::splitLine(columns.at(i), '_', words);
 
-    //...second go around, lets do the actual maths...
-    for(std::size_t i=0; i<mif.columns.size(); i++){
-      if(mif.columns.at(i).find("RP") != std::string::npos){
-        isRP.push_back(true);
-        numRPCols++;
+          // Pull out the Scenario and Year (the first and second words)...
+          std::string scenario;
 
-        // Now we can try to identify the scenario and rp of the load...
-        std::vector<std::string> words = utils::readLine(mif.columns.at(i), '_');
+          if(windRisk){
+            scenario = std::string(words.at(0));
+          }else{
+            scenario = std::string(words.at(0)) + "_" + std::string(words.at(1));
+          }
 
-        // Pull out the Scenario and Year (the first and second words)...
-        std::string scenario;
+          // And the RP (third word, remove "RP" from the start)...
+          int rp = utils::parseNumber<int>(words.at(words.size()-1).substr(2));
 
-        if(windRisk){
-          scenario = words.at(0);
+          // Stick it all on the tab...
+          scenarios.push_back(std::pair<std::string,int>(scenario,rp));
         }else{
-          scenario = words.at(0) + "_" + words.at(1);
+          isRP.push_back(false);
+          scenarios.push_back(std::pair<std::string,int>("None",-9));
         }
-
-        // And the RP (third word, remove "RP" from the start)...
-        int rp = std::stoi(words.at(words.size()-1).substr(2,words.at(words.size()-1).size()-2));
-
-        // Stick it all on the tab...
-        scenarios.push_back(std::pair<std::string,int>(scenario,rp));
-      }else{
-        isRP.push_back(false);
-        scenarios.push_back(std::pair<std::string,int>("None",-9));
       }
-    }
 
-    ///////////////////////////////
-    // Find the unique scenarios...
-    std::vector<std::string> uniqueScenarios;
-    for(auto scenario : scenarios){
-      // Skip things that aren't scenarios...
-      if(scenario.first == "None")
-        continue;
-
-      // Find all the unique scenarios...
-      bool notUnique = false;
-      for(auto unique : uniqueScenarios){
-        if( unique == scenario.first){
-          notUnique = true;
-        }
+      ///////////////////////////////
+      // Find the unique scenarios...
+      for(auto scenario : scenarios){
+        // Skip things that aren't scenarios...
+        if(scenario.first == "None")
+          continue;
+
+        // Is this new?
+        if(std::find(uniqueScenarios.begin(), uniqueScenarios.end(), scenario.first) == uniqueScenarios.end())
+          uniqueScenarios.push_back(scenario.first);
       }
 
-      // Is this new?
-      if(!notUnique){
-        uniqueScenarios.push_back(scenario.first);
+      /////////////////////////////////////////
+      // Lay out the curve of each scenario...
+      for(std::size_t i=0; i<columns.size(); i++)
+        if(isRP.at(i))
+          rpColumns.push_back(i);
+
+      for(const auto& u : uniqueScenarios){
+        // Take the RPs of the scenario (last column first, as fragility::Graph does)...
+        ScenarioCurve curve;
+        for(std::size_t k=rpColumns.size(); k-- > 0; )
+          if(scenarios.at(rpColumns[k]).first == u)
+            curve.rps.push_back(k);
+
+        // ...make sure they run from the longest RP to the shortest...
+        std::stable_sort(curve.rps.begin(), curve.rps.end(), [&](std::size_t a, std::size_t b){
+          return scenarios.at(rpColumns[a]).second > scenarios.at(rpColumns[b]).second;
+        });
+
+        // ...and work out where each sits on the curve.
+        for(auto k : curve.rps)
+          curve.X.push_back(1.0/double(scenarios.at(rpColumns[k]).second));
+        curves.push_back(curve);
       }
-    }
 
 #ifdef CHATTY
-    std::cout << "Number of unique scenarios = " << uniqueScenarios.size() << ":\n";
+      std::cout << "Number of unique scenarios = " << uniqueScenarios.size() << ":\n";
 
-    for(auto u : uniqueScenarios)
-      std::cout << "unique scenario = " << u << "\n";
+      for(auto u : uniqueScenarios)
+        std::cout << "unique scenario = " << u << "\n";
 #endif // CHATTY
 
-    // Get out of Dodge?
-    if(!windRisk){
-      if(highway_index < 0 || length_index < 0){
-        Exception("No highway index");
-        return;
-      }
-    }else{
-      if(mean_speed_index < 0 || tree_cover_index < 0 || length_index < 0){
-        Exception("No mean wind-speed index");
-        return;
+      // Get out of Dodge?
+      if(!windRisk){
+        if(highway_index < 0 || length_index < 0)
+          Exception("No highway index");
+      }else{
+        if(mean_speed_index < 0 || tree_cover_index < 0 || length_index < 0)
+          Exception("No mean wind-speed index");
       }
     }
 
-    // There are seriously large number of assets at little / no risk (flooding, at least)...
-    std::vector<bool> removeFeature;
+    // Helper method to declare the columns once the risk has been added to them...
+    std::vector<std::string> riskColumns(const std::vector<std::string>& columns) const {
+      std::vector<std::string> risk;
+      for(std::size_t i=0; i<columns.size(); i++){
+        risk.push_back(columns.at(i));
+        if(isRP.at(i)){
+          std::vector<std::string_view> words;
+          utils::splitLine(columns.at(i), ' ', words);
+          // NOTE: Using short-version of pFail flag...
+          const std::string name(words.at(0));
+          risk.push_back("  pFail_" + name + " Float");
+          risk.push_back("  eventDamage_" + name + " Float");
+          risk.push_back("  minEventCost_" + name + " Float");
+          risk.push_back("  maxEventCost_" + name + " Float");
+        }
+      }
 
-    // We only really care about the mid file - let's go get it!
-    std::ifstream mid_file;
-    mid_file.open(mif._fileName + ".mid");
+      // Then add the annual probabilities...
+      for(std::size_t i=0; i<uniqueScenarios.size(); i++){
+        risk.push_back("  annualProbability_" + uniqueScenarios.at(i) + " Float");
+        risk.push_back("  EAL_" + uniqueScenarios.at(i) + " Float");
+        risk.push_back("  minEAD_" + uniqueScenarios.at(i) + " Float");
+        risk.push_back("  maxEAD_" + uniqueScenarios.at(i) + " Float");
+      }
+      return risk;
+    }
 
-    // And we are generating a new mid file...
-    std::ofstream new_mid;
-    new_mid.open(outFile + ".mid");
+    // Helper method to work out the CG and costs of each type of asset in a table (the type is the highway tag for roads, and the
+    // first attribute otherwise), as they only depend on the type...
+    AssetTypes assetTypes(const AttributeTable& table) const {
+      AssetTypes types;
+      types.column = &table.columns.at(highway_index > 0 ? highway_index : 0);
+      if(types.column->type == STRING){
+        for(const auto& t : types.column->dictionary->values){
+          types.CG.push_back(f.serviceability ? f.roadServiceabilityCG(t) : f.roadCG(t));
+          types.minCost.push_back(cf.min(t));
+          types.maxCost.push_back(cf.max(t));
+        }
+      }
+      return types;
+    }
 
-    // Somewhere to read the data...
-    std::string line;
+    // Helper method to check to see if the asset in a row of a table is at ANY risk at all...
+    bool atRisk(const AttributeTable& table, const std::size_t row) const {
+      for(auto i : rpColumns)
+        if(table[i].number(row) > 0)
+          return true;
+      return false;
+    }
 
-    int assetsToRemove=0;
-    int assetsAtRisk=0;
-    while(!mid_file.eof()){
-      std::getline(mid_file, line);
-      if(line.size() > 0){
-        // Get the next line...
-        std::vector<std::string> mid_words = utils::readLine(line);
+    // Number of values calculated for each asset (four for each RP column, followed by four for each scenario)...
+    std::size_t numValues(void) const {
+      return 4*(rpColumns.size() + curves.size());
+    }
+
+    // Helper method to calculate the risk of the assets in a batch of rows of a table, giving numValues() values for each row
+    // (row by row). The fragility of the assets is interpolated an RP at a time, and the curve of each scenario integrated for
+    // every asset at once...
+    void risk(const AttributeTable& table, const AssetTypes& types, const std::size_t* rows, const std::size_t n, Workspace& w,
+              std::vector<double>& values) const {
+      const std::size_t numRP = rpColumns.size();
+      const std::size_t nV    = numValues();
+      values.resize(n*nV);
+      w.CG.resize(n);
+      w.length.resize(n);
+      w.minCost.resize(n);
+      w.maxCost.resize(n);
+      w.loads.resize(numRP*n);
+      w.pFail.resize(numRP*n);
+      w.area.resize(n);
+
+      for(std::size_t k=0; k<n; k++){
+        const std::size_t row = rows[k];
 
         // Pull out the CG of the road (either wind or flood, structural or serviceability)...
-        int CG;
         if(windRisk){
-          CG = f.windCG(std::stod(mid_words.at(mean_speed_index)));
+          w.CG[k] = f.windCG(table[mean_speed_index].number(row));
         }else{
-          if( f.serviceability )
-            CG = f.roadServiceabilityCG(mid_words.at(highway_index));
+          const AttributeColumn& highway = table[highway_index];
+          if(highway.type == STRING && &highway == types.column)
+            w.CG[k] = types.CG[highway.codes[row]];
+          else if( f.serviceability )
+            w.CG[k] = f.roadServiceabilityCG(highway.text(row));
           else
-            CG = f.roadCG(mid_words.at(highway_index));
+            w.CG[k] = f.roadCG(highway.text(row));
         }
 
         // Get the length of the asset (km)...
-        double length = std::stod(mid_words.at(length_index));
-
-        // And the min and max costs for this type of asset...
-        double minCost;
-        double maxCost;
+        w.length[k] = table[length_index].number(row);
 
-        // Get the highway cost, guarding on the lack of highway index (i.e. electricity or rail)...
-        if(highway_index > 0){
-          minCost = cf.min(mid_words.at(highway_index));
-          maxCost = cf.max(mid_words.at(highway_index));
+        // And the min and max costs for this type of asset (guarding on the lack of highway index, i.e. electricity or rail)...
+        if(types.column->type == STRING){
+          w.minCost[k] = types.minCost[types.column->codes[row]];
+          w.maxCost[k] = types.maxCost[types.column->codes[row]];
         }else{
-          minCost = cf.min(mid_words.at(0));
-          maxCost = cf.max(mid_words.at(0));
+          w.minCost[k] = cf.min(types.column->text(row));
+          w.maxCost[k] = cf.max(types.column->text(row));
         }
+      }
 
-        // Check to see if the asset is at ANY risk at all...
-        bool noRisk = true;
-        for(std::size_t i=0; i<isRP.size(); i++){
-          if(isRP.at(i)){
-            if(std::stod(mid_words.at(i)) > 0){
-              noRisk = false;
-              break;
-            }
-          }
+      // Calculate the pFail for each RP...
+      for(std::size_t j=0; j<numRP; j++){
+        const AttributeColumn& column = table[rpColumns[j]];
+        for(std::size_t k=0; k<n; k++)
+          w.loads[j*n + k] = column.number(rows[k]);
+        f.probabilities(w.CG.data(), &w.loads[j*n], n, &w.pFail[j*n]);
+      }
+
+      // We now need to loop over each scenario and calculate the Annual probability of failure...
+      for(std::size_t uIndex=0; uIndex<curves.size(); uIndex++){
+        const ScenarioCurve& curve = curves[uIndex];
+        w.points.resize(curve.rps.size());
+        for(std::size_t p=0; p<curve.rps.size(); p++)
+          w.points[p] = &w.pFail[curve.rps[p]*n];
+        fragility::areas(curve.X.data(), w.points.data(), curve.rps.size(), n, w.area.data());
+
+        // The annual probability, the event length damage and min / max costs of damage...
+        for(std::size_t k=0; k<n; k++){
+          const double area = w.area[k];
+          double*      v    = &values[k*nV + 4*(numRP + uIndex)];
+          v[0] = area;
+          v[1] = area * w.length[k];
+          v[2] = area * w.length[k] * w.minCost[k] * 1000000;
+          v[3] = area * w.length[k] * w.maxCost[k] * 1000000;
         }
+      }
 
-        // Make sure we respect the lack of risk in the summary file...
-        if(noRisk && removeNoRiskAssets){
-          removeFeature.push_back(true);
-          assetsToRemove++;
-        }else{
-          removeFeature.push_back(false);
-          assetsAtRisk++;
+      // Then fill in the rest of the values for each RP...
+      for(std::size_t j=0; j<numRP; j++){
+        for(std::size_t k=0; k<n; k++){
+          double pFail = w.pFail[j*n + k];
+
+          // Wind-risk needs some different data...
+          if(windRisk)
+            pFail = pFail * (table[tree_cover_index].number(rows[k]) / 40.0);
+
+          // The probability of failure, the expected length damaged and the minimum and maximum event damage...
+          double* v = &values[k*nV + 4*j];
+          v[0] = pFail;
+          v[1] = w.length[k] * pFail;
+          v[2] = w.length[k] * pFail * w.minCost[k] * 1000000;
+          v[3] = w.length[k] * pFail * w.maxCost[k] * 1000000;
         }
+      }
+    }
 
-        if(!(noRisk && removeNoRiskAssets)){
-          // Loop over the words in the file...
-          for(std::size_t i=0; i<mid_words.size(); i++){
-            // Just pass the incoming data into the new file...
-            new_mid << mid_words.at(i);
-
-            // IFF this is a numeric value, calculate the pFail and add it to the file as well...
-            if(isRP.at(i)){
-              double pFail = f.probability(CG, std::stod(mid_words.at(i)));
-
-              // Wind-risk needs some different data...
-              if(windRisk)
-                pFail = pFail * (std::stod(mid_words.at(tree_cover_index)) / 40.0);
-
-              // Add the probability of failure to the file...
-              new_mid << "," << pFail;
-              // ...and the expected length damaged...
-              new_mid << "," << length * pFail;
-              // ...and the minimum event damage...
-              new_mid << "," << length * pFail * minCost * 1000000;
-              // ...and the maximum event damage...
-              new_mid << "," << length * pFail * maxCost * 1000000;
-            }
+    // Stage for streaming features (see mif_stream.h): replace a batch of features with those at risk (or all of them, if the assets
+    // with no risk are being kept), with the risk added to their attributes as declared by riskColumns...
+    void apply(FeatureStore& batch, const bool removeNoRiskAssets=true) const {
+      const AttributeTable& table = batch.attributes;
+
+      // Lay out the columns, remembering where each of the original columns goes...
+      FeatureStore             risky;
+      std::vector<std::size_t> moved;
+      for(std::size_t i=0; i<table.numColumns(); i++){
+        moved.push_back(risky.attributes.numColumns());
+        risky.attributes.columns.push_back(table[i].slice(0, 0));
+        if(i < isRP.size() && isRP.at(i))
+          for(int k=0; k<4; k++)
+            risky.attributes.addColumn(FLOAT);
+      }
+      for(std::size_t k=0; k<4*uniqueScenarios.size(); k++)
+        risky.attributes.addColumn(FLOAT);
+
+      // Find the assets (at risk)...
+      std::vector<std::size_t> rows;
+      for(std::size_t row=0; row<batch.size(); row++)
+        if(!removeNoRiskAssets || atRisk(table, row))
+          rows.push_back(row);
+
+      // Then copy them over, and their risk (calculated a block at a time)...
+      AssetTypes          types = assetTypes(table);
+      Workspace           w;
+      std::vector<double> values;
+      const std::size_t   nV    = numValues();
+      for(std::size_t k=0; k<rows.size(); k++){
+        if(k % RISK_BLOCK == 0)
+          risk(table, types, &rows[k], std::min(RISK_BLOCK, rows.size() - k), w, values);
+        const std::size_t row = rows[k];
+        const double*     v   = &values[(k % RISK_BLOCK)*nV];
+
+        risky.append(batch.points(row), batch.numPoints(row));
+        std::size_t r = risky.size() - 1;
+        for(std::size_t i=0; i<table.numColumns(); i++){
+          AttributeColumn& c = risky.attributes[moved[i]];
+          if(c.type == FLOAT)
+            c.floats[r] = table[i].floats[row];
+          else if(c.type == INTEGER)
+            c.integers[r] = table[i].integers[row];
+          else
+            c.codes[r] = table[i].codes[row];
+        }
 
-            // Then handle either the next delimiter, or the new line character...
-            new_mid << ",";
+        // ...with the values following each RP column, and the scenarios at the end.
+        for(std::size_t i=0; i<table.numColumns(); i++)
+          if(i < isRP.size() && isRP.at(i))
+            for(int c=0; c<4; c++)
+              risky.attributes[moved[i] + 1 + c].floats[r] = *v++;
+        for(std::size_t c=0; c<4*uniqueScenarios.size(); c++)
+          risky.attributes[risky.attributes.numColumns() - 4*uniqueScenarios.size() + c].floats[r] = *v++;
+      }
+
+      batch = std::move(risky);
+    }
+  };
+
+  // Helper function to addfragility to a MIF file (by default, throwing out any assets with 0 risk). The attributes are read a
+  // block at a time, and the risk of chunks of each block is calculated and formatted in parallel before being written in order...
+  void addRoadFragility(const MIF& mif,
+                        const fragility::FragilityCurve f,
+                        const fragility::CostFunction cf,
+                        const std::string outFile,
+                        const bool removeNoRiskAssets=true,
+                        const int threads=0){
+    // Work out what needs adding to the attributes...
+    RoadFragility plan(mif.columns, f, cf);
+
+    // There are seriously large number of assets at little / no risk (flooding, at least), which are flagged against the first
+    // feature on each line of attributes...
+    std::vector<char> removeFeature(mif.features.size(), false);
+
+    // And we are generating a new mid file...
+    std::ofstream new_mid;
+    new_mid.open(outFile + ".mid");
+    if(!new_mid)
+      Exception("Unable to create MID file (" + outFile + ".mid)");
+
+    // We only really care about the attributes - let's go get them, a block at a time (reading the mid file if it has been defered)!
+    mif.forAttributeBlocks([&](const AttributeTable& table, const std::size_t first, const std::size_t begin, const std::size_t end){
+      RoadFragility::AssetTypes types = plan.assetTypes(table);
+
+      parallel::forOrderedChunks(end - begin, threads, WRITE_CHUNK, [&](std::size_t cBegin, std::size_t cEnd, std::string& text){
+        // Find the assets in the chunk at risk...
+        std::vector<std::size_t> rows;
+        for(std::size_t iF=begin+cBegin; iF<begin+cEnd; iF++){
+          // The features of a region share a single line of attributes, which only needs handling once...
+          if(iF > 0 && mif.midLine[iF] == mif.midLine[iF-1])
+            continue;
+          const std::size_t row = iF - first;
+
+          // Make sure we respect the lack of risk in the summary file...
+          if(removeNoRiskAssets && !plan.atRisk(table, row)){
+            removeFeature[iF] = true;
+            continue;
           }
+          rows.push_back(row);
+        }
+
+        // Then work out their risk a block at a time, and format them...
+        RoadFragility::Workspace w;
+        std::vector<double>      values;
+        const std::size_t        nV = plan.numValues();
+        for(std::size_t k=0; k<rows.size(); k++){
+          if(k % RISK_BLOCK == 0)
+            plan.risk(table, types, &rows[k], std::min(RISK_BLOCK, rows.size() - k), w, values);
+          const std::size_t row = rows[k];
+          const double*     v   = &values[(k % RISK_BLOCK)*nV];
+
+          // Loop over the attributes...
+          for(std::size_t i=0; i<table.numColumns(); i++){
+            // Just pass the incoming data into the new file...
+            table[i].format(row, text);
 
-          // We now need to loop over each scenario and calculate the Annual probability of failure...
-          for(std::size_t uIndex=0; uIndex<uniqueScenarios.size(); uIndex++){
-            std::vector<int>     returnPeriods;
-            std::vector<double>  pFail;
-            for(std::size_t i=0; i<mid_words.size(); i++){
-              if(scenarios.at(i).first == uniqueScenarios.at(uIndex)){
-                returnPeriods.push_back(scenarios.at(i).second);
-                pFail.push_back(f.probability(CG, std::stod(mid_words.at(i))));
+            // IFF this is a numeric value, add its pFail, expected length damaged and min / max event damage as well...
+            if(plan.isRP.at(i)){
+              for(int c=0; c<4; c++){
+                text += ',';
+                utils::appendNumber(text, *v++);
               }
             }
 
-            // Create a graph from the RP and probability of failure...
-            fragility::Graph annualProb(returnPeriods, pFail);
-
-            // Get the areas under the curve...
-            double area = annualProb.area();
-
-            // Add the annualProb to disk...
-            new_mid << area;
+            // Then handle either the next delimiter, or the new line character...
+            text += ',';
+          }
 
-            // And the event length damage and min / max costs of damage...
-            new_mid << "," << area * length;
-            new_mid << "," << area * length * minCost * 1000000;
-            new_mid << "," << area * length * maxCost * 1000000;
+          // And the annual probability of failure (and damage) of each scenario...
+          for(std::size_t uIndex=0; uIndex<plan.uniqueScenarios.size(); uIndex++){
+            utils::appendNumber(text, *v++);
+            for(int c=1; c<4; c++){
+              text += ',';
+              utils::appendNumber(text, *v++);
+            }
 
             // And an appropriate delimiter...
-            if(uIndex < uniqueScenarios.size()-1){
-              new_mid << ",";
-            }else{
-              new_mid << "\n";
-            }
+            text += uIndex < plan.uniqueScenarios.size()-1 ? ',' : '\n';
           }
         }
-      }
-    }
+      }, [&](const std::string& text){
+        new_mid.write(text.data(), text.size());
+      });
+    });
+
+    // Close out the file...
+    new_mid.close();
+
+    // Gather up the flags, one for each entity in the .mif (i.e. each line of attributes)...
+    std::vector<bool> removeEntity;
+    for(std::size_t iF=0; iF<mif.features.size(); iF++)
+      if(iF == 0 || mif.midLine[iF] != mif.midLine[iF-1])
+        removeEntity.push_back(removeFeature[iF]);
 
 #ifdef CHATTY
-    std::cout << "Size of no risk vector = " <<  removeFeature.size() << "\n";
+    std::size_t assetsToRemove = std::count(removeEntity.begin(), removeEntity.end(), true);
+    std::size_t assetsAtRisk   = removeEntity.size() - assetsToRemove;
+    std::cout << "Size of no risk vector = " <<  removeEntity.size() << "\n";
     std::cout << "Assets to remove = " << assetsToRemove << "\n";
     std::cout << "Assets at risk   = " << assetsAtRisk << "\n";
     std::cout << "% discarded      = " << double(assetsToRemove) / double(assetsToRemove + assetsAtRisk) << "\n\n";
 #endif // CHATTY
 
-    // Close out the files...
-    mid_file.close();
-    new_mid.close();
-
-    // We now need to create a new mif file, with the extra header data...
-    std::ifstream mif_file;
-    mif_file.open(mif._fileName + ".mif");
+    // We now need to create a new mif file, with the extra header data (copied from the original a line at a time)...
+    utils::MappedFile mif_file(mif._fileName + ".mif");
+    utils::LineCursor cursor(mif_file.data(), mif_file.data() + mif_file.size());
+    std::string_view  line;
 
     std::ofstream new_mif;
     new_mif.open(outFile + ".mif");
+    if(!new_mif)
+      Exception("Unable to create MIF file (" + outFile + ".mif)");
 
     // The header remains the same...
     for(std::size_t i=0; i<mif.header.size(); i++){
-      std::getline(mif_file, line);
+      cursor.next(line);
       new_mif << line << "\n";
     }
 
     // Get the count of columns (but don't use)...
-    std::getline(mif_file, line);
+    cursor.next(line);
 
     // The count of columns changes...
-    new_mif << "Columns " << mif.columns.size() + 4*numRPCols + 4*uniqueScenarios.size() << "\n";
+    new_mif << "Columns " << mif.columns.size() + 4*plan.numRPCols + 4*plan.uniqueScenarios.size() << "\n";
 
-    // Loop over each column in the file...
-    for(std::size_t i=0; i<mif.columns.size(); i++){
-      std::getline(mif_file, line);
-      new_mif << line << "\n";
-      if(isRP.at(i)){
-        std::vector<std::string> words = utils::readLine(line, ' ');
-        // NOTE: Using short-version of pFail flag...
-        new_mif << "  pFail_" + words.at(0) + " Float\n";
-        new_mif << "  eventDamage_" + words.at(0) + " Float\n";
-        new_mif << "  minEventCost_" + words.at(0) + " Float\n";
-        new_mif << "  maxEventCost_" + words.at(0) + " Float\n";
-      }
-    }
-
-    // Then add the annula probabilities...
-    for(std::size_t i=0; i<uniqueScenarios.size(); i++){
-      new_mif << "  annualProbability_" + uniqueScenarios.at(i) + " Float\n";
-      new_mif << "  EAL_" + uniqueScenarios.at(i) + " Float\n";
-      new_mif << "  minEAD_" + uniqueScenarios.at(i) + " Float\n";
-      new_mif << "  maxEAD_" + uniqueScenarios.at(i) + " Float\n";
-    }
+    // ...as do the columns themselves.
+    for(std::size_t i=0; i<mif.columns.size(); i++)
+      cursor.next(line);
+    for(const auto& column : plan.riskColumns(mif.columns))
+      new_mif << column << "\n";
 
     // There are two lines in the file "Data" and "\n" that need to be parsed to reach the assets...
-    std::getline(mif_file, line); new_mif << line << "\n";
-    std::getline(mif_file, line); new_mif << line << "\n";
-
-    // Then process the remaining lines in the file, observing the callers desire to throw out assets not at risk...
-    int featureIndex = 0;
-    while(!mif_file.eof()){
-      // Read the next line...
-      std::getline(mif_file, line);
-
+    cursor.next(line); new_mif << line << "\n";
+    cursor.next(line); new_mif << line << "\n";
+
+    // Then process the remaining lines in the file, observing the callers desire to throw out assets not at risk (the lines kept
+    // are gathered up, so they go out in large writes)...
+    std::string text;
+    std::size_t featureIndex = 0;
+    while(cursor.next(line)){
       if(line.size() > 0){
-        // Check to see if we are throwing it out and it is a qualifying asset...
-        if(!removeFeature.at(featureIndex) && removeNoRiskAssets)
-          new_mif << line << "\n";
+        // Check to see if we are throwing it out...
+        if(!removeEntity.at(featureIndex)){
+          text += line;
+          text += '\n';
+        }
 
         // Increment the feature index if this is the end of a description...
-        if(line.find("Pen") != std::string::npos )
+        if(line.find("Pen") != std::string_view::npos)
           featureIndex++;
+
+        if(text.size() >= (1 << 20)){
+          new_mif.write(text.data(), text.size());
+          text.clear();
+        }
       }
     }
+    new_mif.write(text.data(), text.size());
 
     //Close the files...
-    mif_file.close();
     new_mif.close();
-
   }
 } // oia_risk_model
 
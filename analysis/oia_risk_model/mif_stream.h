@@ -0,0 +1,207 @@
+#ifndef MIF_STREAM_H
+#define MIF_STREAM_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+
+#include "exceptions.h"
+#include "utils.h"
+#include "mapped_file.h"
+#include "features.h"
+#include "raster_stack.h"
+#include "parallel.h"
+#include "mif.h"
+
+namespace oia_risk_model{
+  // Reader of a MIF / MID pair that hands the features over a batch at a time, rather than holding them all in memory. Along with
+  // MIFWriter, this lets a pipeline of stages run in a fixed amount of memory, however large the file, e.g.
+  //
+  //   MIFReader    in(assetFile);
+  //   int          divided = in.addAttribute("is_divided", "string", 7);
+  //   int          depth   = in.addAttribute("depth", "Float");
+  //   MIFWriter    out(outputFile, in.header, in.columns);
+  //   FeatureStore batch;
+  //   std::vector<std::size_t> parent;
+  //   while(in.read(batch)){
+  //     batch = MIF::divide(ascii, batch, parent, divided);
+  //     sampleRasters(hazards, batch, depth);
+  //     out.write(batch, in.region);
+  //   }
+  //
+  // A stage that changes the columns (e.g. RoadFragility::apply) just needs the writer to be given its columns instead.
+  struct MIFReader{
+    utils::MappedFile        mifFile;       // The mapped .mif
+    utils::MappedFile        midFile;       // The mapped .mid
+    utils::LineCursor        mif;           // Position of the next entity in the .mif
+    utils::LineCursor        mid;           // Position of the next line in the .mid
+    bool                     region=false;  // Has a region been read (after which every entity is treated as one, as for MIF)?
+    std::vector<std::string> header;        // Verbatim representation of the header of the MIF file
+    std::vector<std::string> columns;       // Declaration of each attribute (including any added since)
+    AttributeTable           schema;        // Type of each attribute (without any rows)
+    int                      threads;       // Number of threads used to parse each batch (0 means use all cores)
+
+    // Open a MIF / MID pair (given with or without the extension) and read its header...
+    MIFReader(const std::string fileName, const int threads=0)
+      : mifFile(stripExtension(fileName) + ".mif"), midFile(stripExtension(fileName) + ".mid"),
+        mif(mifFile.data(), mifFile.data() + mifFile.size()), mid(midFile.data(), midFile.data() + midFile.size()),
+        threads(threads){
+      // A file without any data has no features to hand over...
+      if(!MIF::readHeader(mif, header, columns))
+        mif.p = mif.end;
+
+      // The Columns declaration gives the type of each attribute...
+      for(const auto& c : columns)
+        schema.addColumn(attributeType(c));
+    }
+
+    // Helper function to strip the extension (if any) from the name of a MIF file, making sure both parts of the file exist...
+    static std::string stripExtension(const std::string fileName){
+      utils::mifExists(fileName);
+      if(fileName.find(".mif") != std::string::npos || fileName.find(".mid") != std::string::npos)
+        return fileName.substr(0, fileName.length()-4);
+      return fileName;
+    }
+
+    // Helper function to add a new attribute to every feature read from now on (starting out missing), returning the index of the
+    // new column...
+    int addAttribute(const std::string name, const std::string type = "string", const int fieldSize=254){
+      columns.push_back(attributeDeclaration(name, type, fieldSize));
+      schema.addColumn(attributeType(columns.back()));
+      return columns.size() - 1;
+    }
+
+    // Read the next batch of (about) batchSize features into a store, returning false once there are none left (NOTE: the features
+    // of a region are never split between batches, so a batch can be a little larger)...
+    bool read(FeatureStore& batch, const std::size_t batchSize=65536){
+      // Find the entities making up the batch...
+      std::vector<const char*> entities;
+      std::vector<std::size_t> firstFeature(1, 0);
+      std::vector<std::size_t> firstPoint(1, 0);
+      std::size_t              firstRegion = region ? 0 : std::string::npos;
+      std::size_t              numFeatures, numPoints;
+      while(firstFeature.back() < batchSize){
+        const char* start = MIF::indexEntity(mif, region, numFeatures, numPoints);
+        if(!start)
+          break;
+        if(region && firstRegion == std::string::npos)
+          firstRegion = entities.size();
+        entities.push_back(start);
+        firstFeature.push_back(firstFeature.back() + numFeatures);
+        firstPoint.push_back(firstPoint.back() + numPoints);
+      }
+
+      batch = FeatureStore();
+      if(entities.empty())
+        return false;
+
+      // Parse them in parallel...
+      batch.attributes = schema;
+      MIF::readEntities(entities, firstFeature, firstPoint, firstRegion, mif.end, batch, threads);
+
+      // ...along with their lines of the .mid (any attributes added since are left missing).
+      std::vector<std::string_view> lines(entities.size());
+      for(auto& line : lines)
+        mid.next(line);
+      batch.attributes.parse(lines, firstFeature, threads);
+
+      // Everything has been copied out of the files, so the pages read so far are no longer needed...
+      mifFile.release(mif.p);
+      midFile.release(mid.p);
+      return true;
+    }
+  };
+
+  // Writer of a MIF / MID pair, a batch of features at a time (each feature is written as a Pline or Region of its own, and
+  // chunks of each batch are formatted in parallel)...
+  struct MIFWriter{
+    std::ofstream mifFile;  // The .mif being written
+    std::ofstream midFile;  // The .mid being written
+    int           threads;  // Number of threads used to format each batch (0 means use all cores)
+
+    // Create the pair of files (named without the extension), and write the header and the declaration of each column...
+    MIFWriter(const std::string fileName, const std::vector<std::string>& header, const std::vector<std::string>& columns,
+              const int threads=0) : threads(threads){
+      mifFile.open(fileName + ".mif");
+      midFile.open(fileName + ".mid");
+      if(!mifFile || !midFile)
+        Exception("Unable to create MIF file (" + fileName + ")");
+
+      for(const auto& h : header)
+        mifFile << h << "\n";
+      mifFile << "Columns " << columns.size() << "\n";
+      for(const auto& c : columns)
+        mifFile << c << "\n";
+      mifFile << "Data\n";
+      mifFile << "\n";
+    }
+
+    // Write a batch of features (as regions, or plines) and their attributes...
+    void write(const FeatureStore& batch, const bool region=false){
+      // The geometry goes in the .mif...
+      parallel::forOrderedChunks(batch.size(), threads, WRITE_CHUNK, [&](std::size_t begin, std::size_t end, std::string& text){
+        for(std::size_t i=begin; i<end; i++){
+          const geometry::Vec2<double>* pts = batch.points(i);
+          const std::size_t             n   = batch.numPoints(i);
+
+          text += region ? "Region 1\n" : "Pline ";
+          utils::appendInteger(text, n);
+          text += '\n';
+          for(std::size_t iP=0; iP<n; iP++)
+            MIF::appendPoint(text, pts[iP]);
+          text += "    Pen (1,2,0)\n";
+          if(region)
+            text += "    Brush (1,0,16777215)\n";
+        }
+      }, [&](const std::string& text){
+        mifFile.write(text.data(), text.size());
+      });
+
+      // ...and the attributes in the .mid.
+      parallel::forOrderedChunks(batch.size(), threads, WRITE_CHUNK, [&](std::size_t begin, std::size_t end, std::string& text){
+        for(std::size_t i=begin; i<end; i++){
+          batch.attributes.formatRow(i, text);
+          text += '\n';
+        }
+      }, [&](const std::string& text){
+        midFile.write(text.data(), text.size());
+      });
+    }
+
+    // Make sure everything has made it to disk...
+    void close(void){
+      mifFile.close();
+      midFile.close();
+      if(!mifFile || !midFile)
+        Exception("Unable to write MIF file");
+    }
+  };
+
+  // Stage for streaming features: sample every band of a raster stack at the mid-point of each feature in a batch, storing band
+  // b in column firstColumn + b (features the stack's summary rules out, or outside the rasters, get 0)...
+  inline void sampleRasters(const RasterStack& hazards, FeatureStore& batch, const int firstColumn, const int threads=0){
+    parallel::forChunks(batch.size(), threads, [&](std::size_t, std::size_t begin, std::size_t end){
+      // Recover the mid-point of each feature that could be exposed...
+      std::vector<std::size_t>            exposed;
+      std::vector<geometry::Vec2<double>> midPoints;
+      for(std::size_t i=begin; i<end; i++){
+        for(int b=0; b<hazards.numBands; b++)
+          batch.attributes[firstColumn + b].setNumber(i, 0);
+        if(batch.numPoints(i) > 0 && hazards.summary.anyHazard(batch.ll(i), batch.ur(i))){
+          exposed.push_back(i);
+          midPoints.push_back(batch.mid_point(i));
+        }
+      }
+
+      // ...and sample every raster at once.
+      std::vector<float> values(exposed.size()*hazards.numBands);
+      hazards.sample(midPoints.data(), midPoints.size(), values.data());
+      for(std::size_t e=0; e<exposed.size(); e++)
+        for(int b=0; b<hazards.numBands; b++)
+          batch.attributes[firstColumn + b].setNumber(exposed[e], values[e*hazards.numBands + b]);
+    });
+  }
+} // oia_risk_model
+
+#endif //MIF_STREAM_H
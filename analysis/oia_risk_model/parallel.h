@@ -0,0 +1,64 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+namespace oia_risk_model{
+  namespace parallel{
+
+    // Helper function to decide how many threads to use (0 means "one per available core")...
+    inline int numThreads(const int requested=0){
+      if(requested > 0)
+        return requested;
+      return std::max(1, int(std::thread::hardware_concurrency()));
+    }
+
+    // Helper function to split [0, count) into contiguous chunks, and call fn(chunk, begin, end) for each on its own thread...
+    template <typename F>
+    void forChunks(const std::size_t count, const int threads, F fn){
+      // Never use more threads than there is work...
+      std::size_t numChunks = std::max(std::size_t(1), std::min(count, std::size_t(numThreads(threads))));
+
+      // The first chunk is processed on the calling thread, the rest get a thread each...
+      std::vector<std::thread> workers;
+      for(std::size_t c=1; c<numChunks; c++)
+        workers.emplace_back(fn, c, c*count/numChunks, (c+1)*count/numChunks);
+      fn(std::size_t(0), std::size_t(0), count/numChunks);
+
+      // Wait for everyone to finish...
+      for(auto& w : workers)
+        w.join();
+    }
+
+    // Helper function to produce the text for [0, count) in parallel, but write it out in order. The range is worked through in
+    // rounds of a chunk (of chunkSize items) per thread: encode(begin, end, text) appends the text for [begin, end) to text on the
+    // chunk's own thread, then write(text) is called with the text of each chunk in turn on the calling thread (so only a round's
+    // worth of text is ever held in memory, and it goes out in large writes)...
+    template <typename E, typename W>
+    void forOrderedChunks(const std::size_t count, const int threads, const std::size_t chunkSize, E encode, W write){
+      std::vector<std::string> text(numThreads(threads));
+      const std::size_t        roundSize = chunkSize*text.size();
+      for(std::size_t start=0; start<count; start+=roundSize){
+        const std::size_t end       = std::min(count, start + roundSize);
+        const std::size_t numChunks = (end - start + chunkSize - 1) / chunkSize;
+
+        // Encode every chunk in the round at once...
+        forChunks(numChunks, numChunks, [&](std::size_t, std::size_t first, std::size_t last){
+          for(std::size_t c=first; c<last; c++){
+            text[c].clear();
+            encode(start + c*chunkSize, std::min(end, start + (c+1)*chunkSize), text[c]);
+          }
+        });
+
+        // ...then write them out in order.
+        for(std::size_t c=0; c<numChunks; c++)
+          write(text[c]);
+      }
+    }
+  } // parallel
+} // oia_risk_model
+
+#endif //PARALLEL_H
@@ -3,11 +3,280 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <charconv>
+#include <limits>
 
 #include "utils.h"
 #include "geom.h"
+#include "features.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "tile_cache.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 namespace oia_risk_model{
+  // Types available for storing the cells of a raster in memory (and in the binary raster format)...
+  enum CellType : std::int32_t{
+    FLOAT64 = 0,  // 8 bytes per cell, values stored as read
+    FLOAT32 = 1,  // 4 bytes per cell, values rounded to single precision
+    INT16   = 2   // 2 bytes per cell, values stored as round((value - offset) / scale), saturating at the int16 range
+  };
+
+  // Structure describing how the cells of a raster are stored...
+  struct CellFormat{
+    CellType type;    // Storage type of each cell
+    double   scale;   // Scale applied to INT16 cells
+    double   offset;  // Offset applied to INT16 cells
+    // Construct a cell format (scale and offset are only used by INT16 cells)...
+    CellFormat(const CellType type=FLOAT64, const double scale=1, const double offset=0) : type(type), scale(scale), offset(offset) {}
+    // Number of bytes used by each cell...
+    std::size_t bytes(void) const { return type == FLOAT64 ? 8 : type == FLOAT32 ? 4 : 2; }
+    // Compare formats for equality...
+    bool operator==(const CellFormat& f) const { return type == f.type && (type != INT16 || (scale == f.scale && offset == f.offset)); }
+  };
+
+  // Header of the binary raster format: a one-time conversion of an ESRI Ascii raster that can be mapped straight into memory,
+  // followed by nrows*ncols cells (of the given cell type) in the same (bottom-up) order as Ascii::cells. Tiled rasters
+  // (tileSize > 0) instead hold square tiles of tileSize*tileSize cells, bottom-up and padded at the top and right edges.
+  // If summaryBlock > 0, the cells are followed by the HazardSummary::blockMax floats for the raster, and then its zero flags
+  // (one byte per block)...
+  struct BinaryRasterHeader{
+    char         magic[8];      // Always "OIARAST" (used to recognise the file)
+    std::int32_t version;       // Version of the binary format
+    std::int32_t ncols;         // number of columns in the raster
+    std::int32_t nrows;         // number of rows in the raster
+    std::int32_t cellType;      // CellType of the data
+    double       xll;           // xl corner of the raster
+    double       yll;           // yll corner of the raster
+    double       cellsize;      // x, y cell dimension of the data
+    double       nodata;        // value taken as "no data"
+    double       scale;         // Scale applied to INT16 cells
+    double       offset;        // Offset applied to INT16 cells
+    std::int32_t tileSize;      // Width / height of each tile in cells (0 if the raster isn't tiled)
+    std::int32_t summaryBlock;  // Width / height of each block of the stored hazard summary (0 if there isn't one)
+    char         padding[48];   // Pads the header to 128 bytes, so the cell data is aligned
+  };
+  static_assert(sizeof(BinaryRasterHeader) == 128, "Binary raster header must be 128 bytes");
+
+  // Constants identifying the binary raster format...
+  const char         BINARY_RASTER_MAGIC[8] = "OIARAST";
+  const std::int32_t BINARY_RASTER_VERSION  = 3;
+
+  // Default memory budget for the tiles of a tiled raster (bytes)...
+  const std::size_t DEFAULT_TILE_BUDGET = std::size_t(256) << 20;
+
+  // Width / height (in cells) of the blocks in the hazard summary kept with each raster...
+  const int SUMMARY_BLOCK = 16;
+
+  // Coarse summary of a raster holding the maximum value in each block of blockSize*blockSize cells, and whether every cell in
+  // the block is zero, so that areas with no hazard can be rejected without touching the full-resolution grid...
+  //   NOTE: Only cells that are exactly zero (tested at full precision) count as no hazard, so blocks holding negative or tiny
+  //         values are never rejected. The maxima are rounded up to single precision, so they never understate the hazard.
+  struct HazardSummary{
+    double             xll;            // xl corner of the raster
+    double             yll;            // yll corner of the raster
+    double             cellsize;       // x, y cell dimension of the raster
+    int                blockSize = 0;  // Width / height of each block in cells (0 if the summary hasn't been built)
+    int                nbx = 0;        // Number of blocks across the raster
+    int                nby = 0;        // Number of blocks up the raster
+    std::vector<float>        blockMax;  // Maximum value in each block, and at least 0 (bottom-up, as for the raster)
+    std::vector<std::uint8_t> zero;      // Flag for each block, set if every cell in the block is zero
+
+    // Set up the summary for a raster, ready for the block maxima to be filled in...
+    void resize(const int ncols, const int nrows, const double x, const double y, const double cs, const int size){
+      xll       = x;
+      yll       = y;
+      cellsize  = cs;
+      blockSize = size;
+      nbx       = (ncols + size - 1) / size;
+      nby       = (nrows + size - 1) / size;
+      blockMax.assign(std::size_t(nbx)*nby, 0);
+      zero.assign(std::size_t(nbx)*nby, 1);
+    }
+
+    // Helper function to round a value up to single precision...
+    static float roundUp(const double v){
+      float f = float(v);
+      return double(f) < v ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+    // Build the summary from a raster, where value(i) returns the value of the i'th cell (bottom-up, as for Ascii)...
+    template <typename F>
+    void build(const int ncols, const int nrows, const double x, const double y, const double cs, F value, const int threads=0){
+      resize(ncols, nrows, x, y, cs, SUMMARY_BLOCK);
+
+      // Each thread looks after its own rows of blocks...
+      parallel::forChunks(nby, threads, [&](std::size_t, std::size_t begin, std::size_t end){
+        for(std::size_t by=begin; by<end; by++)
+          for(int j=by*blockSize; j<std::min(nrows, int(by+1)*blockSize); j++)
+            for(int i=0; i<ncols; i++){
+              const std::size_t k = by*nbx + i/blockSize;
+              const double      v = value(i + std::size_t(j)*ncols);
+              blockMax[k] = std::max(blockMax[k], roundUp(v));
+              if(v != 0)
+                zero[k] = 0;
+            }
+      });
+    }
+
+    // Read the summary from a stream (laid out as write leaves it), having resized it for the raster...
+    bool read(std::istream& in){
+      return bool(in.read((char*)blockMax.data(), blockMax.size()*sizeof(float)) && in.read((char*)zero.data(), zero.size()));
+    }
+
+    // Write the summary to a stream: the block maxima followed by the zero flags...
+    void write(std::ostream& out) const {
+      out.write((const char*)blockMax.data(), blockMax.size()*sizeof(float));
+      out.write((const char*)zero.data(), zero.size());
+    }
+
+    // Helper method to find the blocks covered by a bounding box (returns false if the box misses the raster altogether)...
+    //   NOTE: Cells are found exactly as Ascii::cellIndices finds them, so every point in the box is in one of the blocks.
+    bool blocks(const geometry::Vec2<double> ll, const geometry::Vec2<double> ur, int& bx0, int& by0, int& bx1, int& by1) const {
+      double cx0 = std::floor((ll.x - xll) / cellsize), cy0 = std::floor((ll.y - yll) / cellsize);
+      double cx1 = std::floor((ur.x - xll) / cellsize), cy1 = std::floor((ur.y - yll) / cellsize);
+      if(cx1 < 0 || cy1 < 0 || cx0 >= double(nbx)*blockSize || cy0 >= double(nby)*blockSize)
+        return false;
+      bx0 = int(std::max(0.0, cx0) / blockSize);
+      by0 = int(std::max(0.0, cy0) / blockSize);
+      bx1 = int(std::min(nbx - 1.0, cx1 / blockSize));
+      by1 = int(std::min(nby - 1.0, cy1 / blockSize));
+      return true;
+    }
+
+    // Helper method to return the maximum value anywhere in a bounding box (0 if the box misses the raster)...
+    double maxInBox(const geometry::Vec2<double> ll, const geometry::Vec2<double> ur) const {
+      // Without a summary, we can't rule anything out...
+      if(blockSize == 0)
+        return std::numeric_limits<double>::infinity();
+
+      int bx0, by0, bx1, by1;
+      if(!blocks(ll, ur, bx0, by0, bx1, by1))
+        return 0;
+
+      float m = 0;
+      for(int by=by0; by<=by1; by++)
+        for(int bx=bx0; bx<=bx1; bx++)
+          m = std::max(m, blockMax[std::size_t(by)*nbx + bx]);
+      return m;
+    }
+
+    // Helper method to test whether anything in a bounding box could be exposed to the hazard...
+    bool anyHazard(const geometry::Vec2<double> ll, const geometry::Vec2<double> ur) const {
+      // Without a summary, we can't rule anything out...
+      if(blockSize == 0)
+        return true;
+
+      int bx0, by0, bx1, by1;
+      if(!blocks(ll, ur, bx0, by0, bx1, by1))
+        return false;
+
+      for(int by=by0; by<=by1; by++)
+        for(int bx=bx0; bx<=bx1; bx++)
+          if(!zero[std::size_t(by)*nbx + bx])
+            return true;
+      return false;
+    }
+
+    // Helper method to test whether anything in a feature's bounding box could be exposed to the hazard...
+    bool anyHazard(const Feature& f) const {
+      return anyHazard(f.ll, f.ur);
+    }
+  };
+
+  // Helper function to name the binary cache of an Ascii raster...
+  inline std::string binaryRasterName(const std::string filename){
+    return filename + ".bin";
+  }
+
+  // Helper function to read the header of a binary raster (returns false if the file isn't a binary raster of the current version)...
+  inline bool readBinaryRasterHeader(const std::string filename, BinaryRasterHeader& h){
+    std::ifstream infile(filename, std::ios::in | std::ios::binary);
+    if(!infile.read((char*)&h, sizeof(h)))
+      return false;
+    return std::memcmp(h.magic, BINARY_RASTER_MAGIC, sizeof(h.magic)) == 0 && h.version == BINARY_RASTER_VERSION;
+  }
+
+  // Helper function to test whether a file is a binary raster (of the current version)...
+  inline bool isBinaryRaster(const std::string filename){
+    BinaryRasterHeader h;
+    return readBinaryRasterHeader(filename, h);
+  }
+
+  // Number of points processed at a time by the batch sampling methods...
+  const std::size_t SAMPLE_BLOCK = 512;
+
+  // Helper function to calculate the hashed index in a raster of a single point, placing it by column and row so that a point off
+  // any side of the raster is outside it (returns -1 if the point falls outside the raster)...
+  inline int gridCellIndex(const geometry::Vec2<double> p, const double xll, const double yll, const double cellsize,
+                           const int ncols, const int nrows){
+    double cx = std::floor((p.x - xll) / cellsize);
+    double cy = std::floor((p.y - yll) / cellsize);
+    return (cx >= 0 && cx < ncols && cy >= 0 && cy < nrows) ? int(cy*ncols + cx) : -1;
+  }
+
+  // Kernel calculating the hashed index in a raster for a contiguous array of points, writing -1 for any point that falls
+  // outside the raster (NOTE: vectorised with AVX2 or SSE2, where the compiler has been allowed to use them)...
+  inline void batchCellIndex(const geometry::Vec2<double>* points, const std::size_t n, int* indices,
+                             const double xll, const double yll, const double cellsize, const int ncols, const int nrows){
+    // Points are stored x, y, x, y...
+    const double* xy = reinterpret_cast<const double*>(points);
+    std::size_t   i  = 0;
+
+#if defined(__AVX2__)
+    const __m256d vxll  = _mm256_set1_pd(xll),  vyll  = _mm256_set1_pd(yll), vcs = _mm256_set1_pd(cellsize);
+    const __m256d vcols = _mm256_set1_pd(ncols), vrows = _mm256_set1_pd(nrows);
+    const __m256d zero  = _mm256_setzero_pd(),   none  = _mm256_set1_pd(-1);
+    for(; i+4<=n; i+=4){
+      // De-interleave four points into x and y lanes...
+      __m256d a  = _mm256_loadu_pd(xy + 2*i);
+      __m256d b  = _mm256_loadu_pd(xy + 2*i + 4);
+      __m256d x  = _mm256_permute4x64_pd(_mm256_unpacklo_pd(a, b), 0xD8);
+      __m256d y  = _mm256_permute4x64_pd(_mm256_unpackhi_pd(a, b), 0xD8);
+
+      // Work out the column and row of each point...
+      __m256d cx = _mm256_floor_pd(_mm256_div_pd(_mm256_sub_pd(x, vxll), vcs));
+      __m256d cy = _mm256_floor_pd(_mm256_div_pd(_mm256_sub_pd(y, vyll), vcs));
+
+      // Mask out anything that falls outside the raster...
+      __m256d in = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(cx, zero, _CMP_GE_OQ), _mm256_cmp_pd(cx, vcols, _CMP_LT_OQ)),
+                                 _mm256_and_pd(_mm256_cmp_pd(cy, zero, _CMP_GE_OQ), _mm256_cmp_pd(cy, vrows, _CMP_LT_OQ)));
+      __m256d id = _mm256_blendv_pd(none, _mm256_add_pd(_mm256_mul_pd(cy, vcols), cx), in);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i), _mm256_cvttpd_epi32(id));
+    }
+#elif defined(__SSE2__)
+    const __m128d vxll  = _mm_set1_pd(xll),  vyll  = _mm_set1_pd(yll), vcs = _mm_set1_pd(cellsize);
+    const __m128d vcols = _mm_set1_pd(ncols), vrows = _mm_set1_pd(nrows);
+    const __m128d zero  = _mm_setzero_pd(),   none  = _mm_set1_pd(-1);
+    for(; i+2<=n; i+=2){
+      // De-interleave two points into x and y lanes...
+      __m128d a  = _mm_loadu_pd(xy + 2*i);
+      __m128d b  = _mm_loadu_pd(xy + 2*i + 2);
+      __m128d ox = _mm_div_pd(_mm_sub_pd(_mm_unpacklo_pd(a, b), vxll), vcs);
+      __m128d oy = _mm_div_pd(_mm_sub_pd(_mm_unpackhi_pd(a, b), vyll), vcs);
+
+      // Mask out anything that falls outside the raster (after which truncation is the same as floor)...
+      __m128d in = _mm_and_pd(_mm_and_pd(_mm_cmpge_pd(ox, zero), _mm_cmplt_pd(ox, vcols)),
+                              _mm_and_pd(_mm_cmpge_pd(oy, zero), _mm_cmplt_pd(oy, vrows)));
+      __m128d cx = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_and_pd(ox, in)));
+      __m128d cy = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_and_pd(oy, in)));
+      __m128d id = _mm_or_pd(_mm_and_pd(in, _mm_add_pd(_mm_mul_pd(cy, vcols), cx)), _mm_andnot_pd(in, none));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(indices + i), _mm_cvttpd_epi32(id));
+    }
+#endif
+
+    // Mop up whatever is left over...
+    for(; i<n; i++)
+      indices[i] = gridCellIndex(points[i], xll, yll, cellsize, ncols, nrows);
+  }
+
   // Structure defining an ESRI Ascii raster...
   struct Ascii{
     int                 ncols;      // number of columns in the Ascii Raster
@@ -16,51 +285,196 @@ namespace oia_risk_model{
     double              yll;        // yll corner of the Ascii Raster
     double              cellsize;   // x, y cell dimension of the incoming data
     double              nodata;     // value taken as "no data"
-    std::vector<double> data;       // 1D vector of doubles storing the data in the Ascii Raster
-    int                 numCells;   // For convenience, store the number of cells (calculated)
+    CellFormat          format;     // How the data in the Ascii Raster is stored
+    std::vector<char>   cells;      // 1D vector storing the data in the Ascii Raster (each cell laid out as described by format)
+    std::size_t         numCells;   // For convenience, store the number of cells (calculated)
+    std::shared_ptr<utils::MappedFile> mapped;  // Binary raster the data is mapped from (empty if the data was read into memory)
+    std::shared_ptr<utils::TileCache>  tiles;   // Tiles of a tiled raster, read on demand (empty unless the raster is tiled)
+    int                 tileSize = 0;           // Width / height of each tile in cells (0 if the raster isn't tiled)
+    HazardSummary       summary;                // Coarse summary of the raster, used to reject areas with no hazard
+
+    // Helper method to build the hazard summary from the cell data...
+    void buildSummary(const int threads=0){
+      summary.build(ncols, nrows, xll, yll, cellsize, [this](std::size_t i){ return value(i); }, threads);
+    }
+
+    // Helper method to read the hazard summary stored in a binary raster (or build it, if there isn't one)...
+    void readSummary(const std::string filename, const BinaryRasterHeader& h, const std::size_t offset){
+      if(h.summaryBlock <= 0){
+        buildSummary();
+        return;
+      }
+
+      summary.resize(ncols, nrows, xll, yll, cellsize, h.summaryBlock);
+      std::ifstream infile(filename, std::ios::in | std::ios::binary);
+      infile.seekg(offset);
+      if(!summary.read(infile))
+        Exception("The binary raster's hazard summary is truncated (" + filename + ")");
+    }
+
+    // Helper method to access the raw cell data, wherever it is stored...
+    const char* cellBytes(void) const {
+      if(mapped)
+        return mapped->data() + sizeof(BinaryRasterHeader);
+      return cells.data();
+    }
+
+    // Helper method to decode the i'th cell of a block of raw cell data...
+    double decode(const char* bytes, const std::size_t i) const {
+      switch(format.type){
+        case FLOAT32:
+          return reinterpret_cast<const float*>(bytes)[i];
+        case INT16:
+          return reinterpret_cast<const std::int16_t*>(bytes)[i]*format.scale + format.offset;
+        default:
+          return reinterpret_cast<const double*>(bytes)[i];
+      }
+    }
+
+    // Helper method to return the value of a cell, whatever type it is stored as (and wherever it is stored)...
+    double value(const std::size_t i) const {
+      if(tiles){
+        std::size_t t, k;
+        tileCell(i, t, k);
+        return tiles->withTile(t, [&](const char* bytes){ return decode(bytes, k); });
+      }
+      return decode(cellBytes(), i);
+    }
+
+    // Helper method to find the tile a cell of a tiled raster belongs to, and the cell's position within it...
+    void tileCell(const std::size_t i, std::size_t& t, std::size_t& k) const {
+      std::size_t col = i % ncols, row = i / ncols;
+      t = (row / tileSize)*numTilesX() + col / tileSize;
+      k = (row % tileSize)*tileSize + col % tileSize;
+    }
+
+    // Helper method to return the number of tiles across a tiled raster...
+    int numTilesX(void) const { return (ncols + tileSize - 1) / tileSize; }
+
+    // Helper method to return the number of tiles up a tiled raster...
+    int numTilesY(void) const { return (nrows + tileSize - 1) / tileSize; }
+
+    // Helper method to set the value of a cell held in memory, converting it to the storage type...
+    void setValue(const std::size_t i, const double v){
+      switch(format.type){
+        case FLOAT32:
+          reinterpret_cast<float*>(cells.data())[i] = float(v);
+          break;
+        case INT16:
+          reinterpret_cast<std::int16_t*>(cells.data())[i] = std::int16_t(std::max(-32768.0, std::min(32767.0, std::round((v - format.offset) / format.scale))));
+          break;
+        default:
+          reinterpret_cast<double*>(cells.data())[i] = v;
+      }
+    }
 
     // Read and interpret a line in the ascii header...
     void readHeaderLine(const std::string line) {
-      std::vector<std::string> key_value = utils::readLine(line, ' ');
+      std::vector<std::string_view> key_value;
+      utils::splitLine(line, ' ', key_value);
 
       // Interpret the key-value pair from the header line...
-      std::string key   = utils::lower_case(key_value.at(0));
-      std::string value = key_value.at(1);
+      std::string      key   = utils::lower_case(std::string(key_value.at(0)));
+      std::string_view value = key_value.at(1);
 
       // Check the incoming strings against the known header...
       if(key == "ncols")
-        ncols = std::stoi(value);
+        ncols = utils::parseNumber<int>(value);
       else if(key == "nrows")
-        nrows = std::stoi(value);
+        nrows = utils::parseNumber<int>(value);
       else if(key == "xllcorner")
-        xll = std::stod(value);
+        xll = utils::parseNumber<double>(value);
       else if(key == "yllcorner")
-        yll = std::stod(value);
+        yll = utils::parseNumber<double>(value);
       else if(key == "cellsize")
-        cellsize = std::stod(value);
+        cellsize = utils::parseNumber<double>(value);
       else if(key == "nodata_value")
-        nodata = std::stoi(value); // nodata is taken to be an int, not a float...
+        nodata = utils::parseNumber<int>(value); // nodata is taken to be an int, not a float...
+    }
+
+    // Make sure the grid described by the header can be indexed: cell indices are ints (see gridCellIndex), so a grid of more
+    // than INT_MAX cells would have points in it sampled as though they were off the raster...
+    void checkGridSize(const std::string filename) const {
+      if(std::int64_t(nrows)*ncols > std::numeric_limits<int>::max())
+        Exception("The raster has too many cells to be indexed (" + std::to_string(ncols) + " columns by " + std::to_string(nrows) +
+                  " rows, where no more than " + std::to_string(std::numeric_limits<int>::max()) + " cells are supported) (" +
+                  filename + ")");
     }
 
-    // Helper method to return the data associated with a point in the ascii raster...
-    double data_at_point(const geometry::Vec2<double> p){
+    // Helper method to return the data associated with a point in the ascii raster (0 if the point is outside the raster)...
+    double data_at_point(const geometry::Vec2<double> p) const {
       // Get the cell index of the point...
-      int cI = cellIndex(p);
+      int cI = cellAt(p);
 
       // Guard on cell being out-of-range...
-      if(cI < 0 || cI >= numCells)
+      if(cI < 0)
         return 0;
 
       // Return the data at that cell index...
-      return data.at(cI);
+      return value(cI);
     }
 
-    // Helper method to calculate hashed index in raster...
+    // Helper method to sample the raster at a contiguous array of points, writing one value per point into out (NOTE: as for
+    // data_at_point, points outside the raster in either direction read as 0)...
+    void sample(const geometry::Vec2<double>* points, const std::size_t n, double* out) const {
+      int indices[SAMPLE_BLOCK];
+      for(std::size_t start=0; start<n; start+=SAMPLE_BLOCK){
+        std::size_t m = std::min(SAMPLE_BLOCK, n - start);
+
+        // Calculate the cell indices for a block of points...
+        batchCellIndex(points + start, m, indices, xll, yll, cellsize, ncols, nrows);
+
+        // ...and gather the data, with the storage type resolved once per block.
+        double* o = out + start;
+        if(tiles){
+          // Group the points by tile, so that each tile is fetched once per block...
+          std::size_t order[SAMPLE_BLOCK], tile[SAMPLE_BLOCK], cell[SAMPLE_BLOCK], count = 0;
+          for(std::size_t k=0; k<m; k++){
+            if(indices[k] < 0){
+              o[k] = 0;
+              continue;
+            }
+            tileCell(indices[k], tile[k], cell[k]);
+            order[count++] = k;
+          }
+          std::sort(order, order + count, [&](std::size_t a, std::size_t b){ return tile[a] < tile[b]; });
+
+          // ...and decode all the points in a tile together.
+          for(std::size_t s=0, e; s<count; s=e){
+            for(e=s+1; e<count && tile[order[e]] == tile[order[s]]; e++);
+            tiles->withTile(tile[order[s]], [&](const char* bytes){
+              for(std::size_t q=s; q<e; q++)
+                o[order[q]] = decode(bytes, cell[order[q]]);
+            });
+          }
+        }else if(format.type == FLOAT32){
+          const float* c = reinterpret_cast<const float*>(cellBytes());
+          for(std::size_t k=0; k<m; k++)
+            o[k] = indices[k] < 0 ? 0 : c[indices[k]];
+        }else if(format.type == INT16){
+          const std::int16_t* c = reinterpret_cast<const std::int16_t*>(cellBytes());
+          for(std::size_t k=0; k<m; k++)
+            o[k] = indices[k] < 0 ? 0 : c[indices[k]]*format.scale + format.offset;
+        }else{
+          const double* c = reinterpret_cast<const double*>(cellBytes());
+          for(std::size_t k=0; k<m; k++)
+            o[k] = indices[k] < 0 ? 0 : c[indices[k]];
+        }
+      }
+    }
+
+    // Helper method to calculate hashed index in raster (NOTE: this isn't checked against the raster, so a point off the side
+    // wraps onto a neighbouring row; use cellAt to look up the data at a point)...
     int cellIndex(const geometry::Vec2<double> p) const {
       geometry::Vec2<long double> offset((p.x - xll) / cellsize, (p.y - yll) / cellsize);
       return floor(offset.x) + floor(offset.y)*ncols;
     }
 
+    // Helper method to find the cell a point falls in, by column and row (or -1 if the point is outside the raster)...
+    int cellAt(const geometry::Vec2<double> p) const {
+      return gridCellIndex(p, xll, yll, cellsize, ncols, nrows);
+    }
+
     // Helper method to recover i, j index in raster...
     geometry::Vec2<int> cellIndices(const geometry::Vec2<double> p) const {
       geometry::Vec2<double> offset((p.x - xll) / cellsize, (p.y - yll) / cellsize);
@@ -80,16 +494,27 @@ namespace oia_risk_model{
       return geometry::Vec2<double>(p.x - x0, p.y - y0);
     }
 
-    // Method to calculate the points at which a line-segment intersects the Ascii grid lines / graticules...
-    std::vector<geometry::Vec2<double>> findIntersections(const geometry::Line2<double> line) const {
+    // Method to walk a line-segment across the Ascii grid (an Amanatides-Woo style traversal), calling
+    // fn(cellIndex, entry, exit, length) for each piece of the line that lies in a single cell, in order along the line (the
+    // cell index is -1 for any piece that lies outside the raster, whichever side it is off)...
+    //   NOTE: Nothing is allocated, and the only square-root is the length of the whole line. Grid / graticule crossings are
+    //         calculated exactly as they always have been, so the pieces join up with the points findIntersections returns.
+    template <typename F>
+    void traverse(const geometry::Line2<double> line, F fn) const {
       // First, calculate the run and rise of the line...
       double run  = (line.end.x - line.start.x);
       double rise = (line.end.y - line.start.y);
 
-      // Calculate the length of the line segment being passed in for testing...
+      // Calculate the length of the line segment being passed in...
       double length = line.length();
 
-      // Work out where the start-point of the line falls in the cell...
+      // Helper to hash a column and row, checking it is in the raster...
+      auto index = [this](const geometry::Vec2<int> c){
+        return (c.x >= 0 && c.x < ncols && c.y >= 0 && c.y < nrows) ? c.x + c.y*ncols : -1;
+      };
+
+      // Work out which cell the line starts in, and where the start-point falls in the cell...
+      geometry::Vec2<int>    cell  = cellIndices(line.start);
       geometry::Vec2<double> delta = offsetInCell(line.start);
 
       // Determine which cell boundaries the line will cross (N or S, E or W)...
@@ -100,76 +525,339 @@ namespace oia_risk_model{
       double dN = north ? cellsize - delta.y : -delta.y;
       double dE = east  ? cellsize - delta.x : -delta.x;
 
-      // Calculate the positions at which the line crosses the grid graticules...
-      geometry::Vec2<double> pN(dN*run/rise, dN);
-      geometry::Vec2<double> pE(dE, dE*rise/run);
+      // ...expressed as a fraction of the way along the line (infinite if the line never crosses that way).
+      double tN = dN / rise;
+      double tE = dE / run;
+
+      // Walk the line, one cell at a time...
+      geometry::Vec2<double> entry = line.start;
+      double                 t     = 0;
+      while(tE < 1 || tN < 1){
+        geometry::Vec2<double> exit;
+        double                 tExit;
+        int                    cI = index(cell);
+
+        // Step into whichever neighbouring cell the line reaches first...
+        if(tE < tN){
+          exit  = line.start + geometry::Vec2<double>(dE, dE*rise/run);
+          tExit = tE;
+          cell.x += east - 1;
+          dE     += double(east-1)*cellsize;
+          tE      = dE / run;
+        }else{
+          exit  = line.start + geometry::Vec2<double>(dN*run/rise, dN);
+          tExit = tN;
+          cell.y += north - 1;
+          dN     += double(north-1)*cellsize;
+          tN      = dN / rise;
+        }
+
+        // Hand the piece of the line in the cell we are leaving to the caller...
+        fn(cI, entry, exit, (tExit - t)*length);
+        entry = exit;
+        t     = tExit;
+      }
+
+      // ...and finally, the piece in the cell the line ends in.
+      fn(index(cell), entry, line.end, (1 - t)*length);
+    }
 
+    // Method to calculate the points at which a line-segment intersects the Ascii grid lines / graticules...
+    std::vector<geometry::Vec2<double>> findIntersections(const geometry::Line2<double> line) const {
       // Create a vector of grid / graticule crossings to return to the caller...
       std::vector<geometry::Vec2<double>> crossings;
 
-      // Append the start point of the line to the vector of crossings...
-      crossings.push_back(line.start);
-
-      // As long as there is a crossing point BEFORE the end of the line, we can keep looping...
-      while(pE.length() < length || pN.length() < length){
-        // Add the closest crossing point to the vector of grid / graticule crossings...
-        if(pE.length() < pN.length()){
-          crossings.push_back(line.start + pE);
-          // Update the distance to the next graticule...
-          dE += double(east-1)*cellsize;
-          // Calculate the position of the crossing point on the next grid / graticule line...
-          pE = geometry::Vec2<double>(dE, dE*rise/run);
-        }else{
-          crossings.push_back(line.start + pN);
-          // Update the distance to the next graticule...
-          dN += double(north-1)*cellsize;
-          // Calculate the position of the crossing point on the next grid / graticule line...
-          pN = geometry::Vec2<double>(dN*run/rise, dN);
-        }
-      }
+      // The start of each piece of the line is either the start point of the line, or a crossing...
+      traverse(line, [&](int, const geometry::Vec2<double>& entry, const geometry::Vec2<double>&, double){
+        crossings.push_back(entry);
+      });
 
       // Return the vector of grid / graticule crossing points that exist bbetween the start and end of the line...
       return crossings;
     }
 
-    // Ascii grid Constructor...
-    Ascii(const std::string filename){
-      // Test if the ascii raster exists...
-      if(!utils::exists(filename))
-        Exception("The Ascii raster you are trying to open does not exist (" + filename + ")");
+    // Parse a block of rows of an ESRI Ascii raster straight into the data (NOTE: firstRow counts from the top of the file)...
+    void parseRows(const char* p, const char* end, int firstRow){
+      int row = firstRow;
+      while(p < end){
+        // Find the end of the row...
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if(!eol)
+          eol = end;
+
+        // Rows are stored bottom-up (in line with the file format)...
+        int j = nrows - 1 - row;
+
+        // Walk the values in the row...
+        int i = 0;
+        while(p < eol){
+          // Skip the white space between values...
+          while(p < eol && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+          if(p == eol)
+            break;
+
+          // Make sure the value belongs in the grid...
+          if(j < 0 || i >= ncols)
+            Exception("The Ascii raster has more data than its header describes");
+
+          // from_chars doesn't accept a leading plus...
+          if(*p == '+')
+            p++;
+
+          // Parse the value, and stick it on the tab...
+          double value;
+          auto result = std::from_chars(p, eol, value);
+          if(result.ec != std::errc())
+            Exception("Unable to parse Ascii raster value (" + std::string(p, std::min(eol, p + 16)) + ")");
+          setValue(i + std::size_t(j)*ncols, std::max(0.0, value));
+          p = result.ptr;
+          i++;
+        }
 
-      // Open the nominated file...
-      std::ifstream infile;
-      infile.open(filename);
+        // Move on to the next row...
+        p = std::min(eol + 1, end);
+        row++;
+      }
+    }
 
-      // Create somewhere to read the data...
-      std::string line;
+    // Read the data from an ESRI Ascii raster on disk, splitting the rows across threads (0 means use all cores)...
+    void readAscii(const std::string filename, const int threads=0){
+      // Map the nominated file...
+      utils::MappedFile file(filename);
+      const char* p   = file.data();
+      const char* end = file.data() + file.size();
 
       // Read the header, process the data...
-      for(int i=0; i<6; i++){
-        std::getline(infile, line);
-        readHeaderLine(line);
+      for(int i=0; i<6 && p < end; i++){
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if(!eol)
+          eol = end;
+        readHeaderLine(std::string(p, eol));
+        p = std::min(eol + 1, end);
       }
+      checkGridSize(filename);
 
       // Reserve some space for the data that is in the file...
-      data.resize(nrows*ncols);
-
-      // Read the rest of the data (NOTE: The file is being read in top-bottom in line with the file format)...
-      for(int j=nrows-1; j>0; j--){
-          std::getline(infile, line);
-          // Extract the data from the line...
-          std::vector<std::string> words = utils::readLine(line,' ');
-          // Stick the data on the tab...
-          int i=0;
-          for(auto word : words){
-            // Calculate the index of the data, populate it...
-            data.at(i + j*ncols) = std::max(0.0,std::stod(word));
-            i++;
-          }
+      cells.assign(std::size_t(nrows)*ncols*format.bytes(), 0);
+
+      // Split the body of the file into byte ranges, each starting at the beginning of a row...
+      int numChunks = parallel::numThreads(threads);
+      std::vector<const char*> starts(numChunks + 1, end);
+      starts.at(0) = p;
+      for(int c=1; c<numChunks; c++){
+        const char* s = std::max(starts.at(c-1), p + (end - p)*c/numChunks);
+        if(s > p && s < end){
+          const char* nl = static_cast<const char*>(std::memchr(s - 1, '\n', end - (s - 1)));
+          s = nl ? nl + 1 : end;
+        }
+        starts.at(c) = s;
       }
 
+      // Count the rows in each range, so we know which row each range starts at...
+      std::vector<int> firstRow(numChunks + 1, 0);
+      parallel::forChunks(numChunks, numChunks, [&](std::size_t, std::size_t begin, std::size_t finish){
+        for(std::size_t c=begin; c<finish; c++){
+          int n = 0;
+          for(const char* q = starts.at(c); (q = static_cast<const char*>(std::memchr(q, '\n', starts.at(c+1) - q))); q++)
+            n++;
+          firstRow.at(c+1) = n;
+        }
+      });
+      for(int c=0; c<numChunks; c++)
+        firstRow.at(c+1) += firstRow.at(c);
+
+      // ...and then parse the ranges concurrently.
+      parallel::forChunks(numChunks, numChunks, [&](std::size_t, std::size_t begin, std::size_t finish){
+        for(std::size_t c=begin; c<finish; c++)
+          parseRows(starts.at(c), starts.at(c+1), firstRow.at(c));
+      });
+
       // For ease of testing later on, store the total number of cells in the grid...
-      numCells = data.size() - 1;
+      numCells = std::size_t(nrows)*ncols;
+
+      // Summarise the hazard, while we are at it...
+      buildSummary(threads);
+    }
+
+    // Open a tiled binary raster on disk, holding no more than memoryBudget bytes of tiles in memory at once...
+    void openTiled(const std::string filename, const std::size_t memoryBudget){
+      BinaryRasterHeader h;
+      readBinaryRasterHeader(filename, h);
+      ncols    = h.ncols;
+      nrows    = h.nrows;
+      xll      = h.xll;
+      yll      = h.yll;
+      cellsize = h.cellsize;
+      nodata   = h.nodata;
+      format   = CellFormat(CellType(h.cellType), h.scale, h.offset);
+      tileSize = h.tileSize;
+      checkGridSize(filename);
+
+      // Make sure the tiles are all there...
+      std::size_t tileBytes = std::size_t(tileSize)*tileSize*format.bytes();
+      if(std::filesystem::file_size(filename) < sizeof(BinaryRasterHeader) + std::size_t(numTilesX())*numTilesY()*tileBytes)
+        Exception("The tiled raster is truncated (" + filename + ")");
+
+      // Tiles are only read when they are needed...
+      tiles = std::make_shared<utils::TileCache>(filename, sizeof(BinaryRasterHeader), tileBytes, memoryBudget);
+
+      // For ease of testing later on, store the total number of cells in the grid...
+      numCells = std::size_t(nrows)*ncols;
+
+      // The hazard summary follows the tiles...
+      readSummary(filename, h, sizeof(BinaryRasterHeader) + std::size_t(numTilesX())*numTilesY()*tileBytes);
+    }
+
+    // Map the data from a binary raster on disk (NOTE: nothing is read until a cell is accessed)...
+    void mapBinary(const std::string filename){
+      mapped = std::make_shared<utils::MappedFile>(filename);
+
+      // Make sure the file is big enough to hold a header...
+      if(mapped->size() < sizeof(BinaryRasterHeader))
+        Exception("The binary raster is truncated (" + filename + ")");
+
+      // Copy the header out of the file...
+      BinaryRasterHeader h;
+      std::memcpy(&h, mapped->data(), sizeof(h));
+      ncols    = h.ncols;
+      nrows    = h.nrows;
+      xll      = h.xll;
+      yll      = h.yll;
+      cellsize = h.cellsize;
+      nodata   = h.nodata;
+      format   = CellFormat(CellType(h.cellType), h.scale, h.offset);
+      checkGridSize(filename);
+
+      // ...and check the data is all there.
+      if(mapped->size() < sizeof(BinaryRasterHeader) + std::size_t(nrows)*ncols*format.bytes())
+        Exception("The binary raster is truncated (" + filename + ")");
+
+      // For ease of testing later on, store the total number of cells in the grid...
+      numCells = std::size_t(nrows)*ncols;
+
+      // The hazard summary follows the cells...
+      readSummary(filename, h, sizeof(BinaryRasterHeader) + std::size_t(nrows)*ncols*format.bytes());
+    }
+
+    // Helper method to fill out a binary raster header describing this raster...
+    BinaryRasterHeader binaryHeader(const int tiled=0) const {
+      BinaryRasterHeader h;
+      std::memset(&h, 0, sizeof(h));
+      std::memcpy(h.magic, BINARY_RASTER_MAGIC, sizeof(h.magic));
+      h.version  = BINARY_RASTER_VERSION;
+      h.ncols    = ncols;
+      h.nrows    = nrows;
+      h.xll      = xll;
+      h.yll      = yll;
+      h.cellsize = cellsize;
+      h.nodata   = nodata;
+      h.cellType = format.type;
+      h.scale    = format.scale;
+      h.offset   = format.offset;
+      h.tileSize = tiled;
+      h.summaryBlock = summary.blockSize;
+      return h;
+    }
+
+    // Write the raster to disk in the binary format, so it can be mapped directly next time...
+    void writeBinary(const std::string filename) const {
+      if(tiles)
+        Exception("Tiled rasters can't be written as flat binary rasters (" + filename + ")");
+
+      BinaryRasterHeader h = binaryHeader();
+
+      // Write to a temporary file of our own first, so other processes never map a partially written raster...
+      std::string tmp = utils::temporaryName(filename);
+      std::ofstream b(tmp, std::ios::out | std::ios::binary);
+      b.write((char*)&h, sizeof(h));
+      b.write(cellBytes(), std::size_t(nrows)*ncols*format.bytes());
+      summary.write(b);
+      b.close();
+
+      // ...then move it into place (if that fails, a raster put there by another process will do just as well).
+      if(!utils::replaceFile(tmp, filename, bool(b)) && !isBinaryRaster(filename))
+        Exception("Unable to write binary raster (" + filename + ")");
+    }
+
+    // Write the raster to disk as a tiled binary raster, which can be sampled with a bounded memory footprint...
+    //   NOTE: Converting a mapped binary raster only pulls the rows being tiled into the page cache, so the full grid
+    //         never needs to be held in memory.
+    void writeTiled(const std::string filename, const int size=256) const {
+      if(tiles)
+        Exception("The raster is already tiled (" + filename + ")");
+
+      BinaryRasterHeader h = binaryHeader(size);
+
+      // Somewhere to assemble one band of tiles (i.e. a row of tiles across the raster)...
+      std::size_t bytes     = format.bytes();
+      std::size_t tileBytes = std::size_t(size)*size*bytes;
+      int         ntx       = (ncols + size - 1) / size;
+      int         nty       = (nrows + size - 1) / size;
+      std::vector<char> band(ntx*tileBytes);
+
+      // Write to a temporary file of our own first, so other processes never read a partially written raster...
+      std::string tmp = utils::temporaryName(filename);
+      std::ofstream b(tmp, std::ios::out | std::ios::binary);
+      b.write((char*)&h, sizeof(h));
+
+      // Work up the raster, one band of tiles at a time...
+      for(int ty=0; ty<nty; ty++){
+        std::fill(band.begin(), band.end(), 0);
+        for(int r=0; r<size && ty*size + r < nrows; r++){
+          const char* row = cellBytes() + (std::size_t(ty*size + r)*ncols)*bytes;
+          // Copy the row into each of the tiles it crosses...
+          for(int tx=0; tx<ntx; tx++){
+            int n = std::min(size, ncols - tx*size);
+            std::memcpy(band.data() + tx*tileBytes + std::size_t(r)*size*bytes, row + std::size_t(tx)*size*bytes, n*bytes);
+          }
+        }
+        b.write(band.data(), band.size());
+      }
+      summary.write(b);
+      b.close();
+
+      // ...then move it into place (if that fails, a raster put there by another process will do just as well).
+      if(!utils::replaceFile(tmp, filename, bool(b)) && !isBinaryRaster(filename))
+        Exception("Unable to write tiled raster (" + filename + ")");
+    }
+
+    // Ascii grid Constructor (accepts either an ESRI Ascii raster or a binary raster written by writeBinary)...
+    //   cache:   keep a binary copy of an ESRI Ascii raster next to it, and map that instead whenever it is up-to-date.
+    //   threads: number of threads used to parse an ESRI Ascii raster (0 means use all cores).
+    //   format:  how to store the cells of an ESRI Ascii raster (binary rasters keep the format they were written with).
+    //   memoryBudget: maximum number of bytes of tiles held in memory when reading a tiled raster (written by writeTiled).
+    Ascii(const std::string filename, const bool cache=false, const int threads=0, const CellFormat format=CellFormat(),
+          const std::size_t memoryBudget=DEFAULT_TILE_BUDGET) : format(format){
+      // Test if the ascii raster exists...
+      if(!utils::exists(filename))
+        Exception("The Ascii raster you are trying to open does not exist (" + filename + ")");
+
+      // Binary rasters can be mapped as they are, while tiled rasters are read on demand...
+      BinaryRasterHeader h;
+      if(readBinaryRasterHeader(filename, h)){
+        if(h.tileSize > 0)
+          openTiled(filename, memoryBudget);
+        else
+          mapBinary(filename);
+        return;
+      }
+
+      // Is there an up-to-date binary copy of the raster (in the requested format) we can use instead?
+      std::string binFile = binaryRasterName(filename);
+      if(cache && readBinaryRasterHeader(binFile, h) && h.tileSize == 0 &&
+         CellFormat(CellType(h.cellType), h.scale, h.offset) == format &&
+         std::filesystem::last_write_time(binFile) >= std::filesystem::last_write_time(filename)){
+        mapBinary(binFile);
+        return;
+      }
+
+      // Otherwise, parse the text...
+      readAscii(filename, threads);
+
+      // ...and keep a binary copy for the next time around.
+      if(cache)
+        writeBinary(binFile);
     }
   };
 
@@ -180,7 +868,8 @@ namespace oia_risk_model{
     steeringFile.open(fileName);
 
     // Create a string into which the file should be read...
-    std::string line;
+    std::string                   line;
+    std::vector<std::string_view> words;
 
     // Create a vector of raster files to return to the caller...
     std::vector<std::pair<std::string,std::string>> rasterFiles;
@@ -188,7 +877,7 @@ namespace oia_risk_model{
     // Read the file...
     while(!steeringFile.eof()){
       std::getline(steeringFile, line);
-      std::vector<std::string> words = utils::readLine(line);
+      utils::splitLine(line, ',', words);
       if(words.size() > 0){
         rasterFiles.push_back(std::pair<std::string,std::string>(words.at(0), words.at(1)));
       }
@@ -0,0 +1,117 @@
+#ifndef RASTER_STACK_H
+#define RASTER_STACK_H
+
+#include <vector>
+#include <string>
+
+#include "exceptions.h"
+#include "geom.h"
+#include "raster.h"
+#include "parallel.h"
+
+namespace oia_risk_model{
+  // Structure holding a stack of rasters that share a grid, with the values for each cell stored together (band-interleaved)
+  // so that a single lookup returns every band for a point...
+  //   NOTE: The whole stack is held in memory as floats, i.e. numBands*ncols*nrows*4 bytes (1GB for 10 bands of a 5000x5000
+  //         grid), whatever CellFormat or tile budget the rasters were read with. Each raster is only held until it has been
+  //         copied into the stack, but grids too large for that need to be sampled a raster at a time (as mapped or tiled
+  //         Ascii rasters) instead.
+  struct RasterStack{
+    int                      ncols;     // number of columns in each raster
+    int                      nrows;     // number of rows in each raster
+    double                   xll;       // xl corner of the rasters
+    double                   yll;       // yll corner of the rasters
+    double                   cellsize;  // x, y cell dimension of the rasters
+    int                      numBands;  // Number of rasters in the stack
+    std::size_t              numCells;  // For convenience, store the number of cells (calculated, as for Ascii)
+    std::vector<std::string> names;     // Name of each band (the attribute name from the steering file)
+    std::vector<float>       data;      // Cell data, stored cell-by-cell with the bands for each cell held contiguously
+    HazardSummary            summary;   // Coarse summary of the largest value in any band, used to reject areas with no hazard
+
+    // Helper method to find the cell a point falls in, by column and row (or -1 if the point is outside the rasters)...
+    int cellAt(const geometry::Vec2<double> p) const {
+      return gridCellIndex(p, xll, yll, cellsize, ncols, nrows);
+    }
+
+    // Helper method to return the values of every band at a cell index...
+    const float* values(const std::size_t cI) const {
+      return data.data() + cI*numBands;
+    }
+
+    // Helper method to return the values of every band at a point (or nullptr if the point is outside the rasters)...
+    const float* values_at_point(const geometry::Vec2<double> p) const {
+      // Get the cell index of the point...
+      int cI = cellAt(p);
+
+      // Guard on cell being out-of-range...
+      if(cI < 0)
+        return nullptr;
+
+      return values(cI);
+    }
+
+    // Helper method to sample every band at a contiguous array of points, writing numBands values per point into out (NOTE: as
+    // for Ascii::sample, points outside the rasters read as 0)...
+    void sample(const geometry::Vec2<double>* points, const std::size_t n, float* out) const {
+      int indices[SAMPLE_BLOCK];
+      for(std::size_t start=0; start<n; start+=SAMPLE_BLOCK){
+        std::size_t m = std::min(SAMPLE_BLOCK, n - start);
+
+        // Calculate the cell indices for a block of points...
+        batchCellIndex(points + start, m, indices, xll, yll, cellsize, ncols, nrows);
+
+        // ...and copy out the bands for each.
+        for(std::size_t k=0; k<m; k++){
+          float* o = out + (start + k)*numBands;
+          if(indices[k] < 0)
+            std::fill(o, o + numBands, 0.0f);
+          else
+            std::copy(values(indices[k]), values(indices[k]) + numBands, o);
+        }
+      }
+    }
+
+    // Load a stack from a vector of (raster file, band name) pairs, as read from a raster steering file...
+    //   cache:   keep binary copies of the rasters, as for Ascii.
+    //   threads: number of threads used to parse and interleave each raster (0 means use all cores).
+    RasterStack(const std::vector<std::pair<std::string,std::string>> rasterFiles, const bool cache=false, const int threads=0){
+      numBands = rasterFiles.size();
+      if(numBands == 0)
+        Exception("A raster stack needs at least one raster");
+
+      // Load each raster in turn, and interleave it with the others...
+      for(int b=0; b<numBands; b++){
+        Ascii ascii(rasterFiles.at(b).first, cache, threads);
+        names.push_back(rasterFiles.at(b).second);
+
+        // The first raster defines the grid...
+        if(b == 0){
+          ncols    = ascii.ncols;
+          nrows    = ascii.nrows;
+          xll      = ascii.xll;
+          yll      = ascii.yll;
+          cellsize = ascii.cellsize;
+          numCells = ascii.numCells;
+          data.resize(std::size_t(nrows)*ncols*numBands, 0);
+        }
+
+        // ...which all the others need to share.
+        if(ascii.ncols != ncols || ascii.nrows != nrows || ascii.xll != xll || ascii.yll != yll || ascii.cellsize != cellsize)
+          Exception("Rasters in a stack must share a common origin, cellsize and dimension (" + rasterFiles.at(b).first + ")");
+
+        // Copy the band into place...
+        parallel::forChunks(std::size_t(nrows)*ncols, threads, [&](std::size_t, std::size_t begin, std::size_t end){
+          for(std::size_t i=begin; i<end; i++)
+            data[i*numBands + b] = ascii.value(i);
+        });
+      }
+
+      // Summarise the hazard across every band...
+      summary.build(ncols, nrows, xll, yll, cellsize, [this](std::size_t i){
+        return *std::max_element(values(i), values(i) + numBands);
+      }, threads);
+    }
+  };
+} // oia_risk_model
+
+#endif //RASTER_STACK_H
@@ -0,0 +1,105 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "exceptions.h"
+
+namespace oia_risk_model{
+  namespace utils{
+
+    // Bounded, least-recently-used cache of fixed-size blocks ("tiles") read on demand from a file on disk...
+    //   NOTE: The lock only guards the bookkeeping. Each tile is read (once) outside it, so threads wanting different tiles
+    //         read them concurrently, and a tile that is evicted while a thread is using it stays in memory until that thread
+    //         lets go of it (so the budget can be exceeded by one tile per thread).
+    struct TileCache{
+      // A single tile, read from disk by whichever thread asks for it first...
+      struct Tile{
+        std::once_flag    read;   // Set once the tile has been read
+        std::vector<char> bytes;  // Data of the tile
+      };
+
+      int                    fd = -1;       // File descriptor of the tiled file
+      std::size_t            dataOffset;    // Byte offset of the first tile in the file
+      std::size_t            tileBytes;     // Size of each tile in bytes
+      std::size_t            capacity;      // Maximum number of tiles held in memory (calculated from the memory budget)
+      std::list<std::size_t> lru;           // Indices of the cached tiles, most recently used first
+      std::unordered_map<std::size_t, std::pair<std::shared_ptr<Tile>, std::list<std::size_t>::iterator>> tiles;  // Cached tiles
+      std::mutex             lock;          // Guards the bookkeeping, so a raster can be sampled from several threads
+
+      // Open the tiled file, holding at most memoryBudget bytes of tiles in memory at once...
+      TileCache(const std::string fileName, const std::size_t dataOffset, const std::size_t tileBytes, const std::size_t memoryBudget)
+        : dataOffset(dataOffset), tileBytes(tileBytes), capacity(std::max(std::size_t(1), memoryBudget / tileBytes)){
+        fd = open(fileName.c_str(), O_RDONLY);
+        if(fd < 0)
+          Exception("Unable to open tiled file (" + fileName + ")");
+      }
+
+      // The cache owns the file descriptor, so it can't be copied...
+      TileCache(const TileCache&) = delete;
+      TileCache& operator=(const TileCache&) = delete;
+
+      ~TileCache(){
+        if(fd >= 0)
+          close(fd);
+      }
+
+      // Helper method to find the nominated tile in the cache, adding it (and evicting the oldest tile) if it isn't there. The
+      // tile stays in memory for as long as the caller holds on to it, but may not have been read yet...
+      std::shared_ptr<Tile> pin(const std::size_t t){
+        std::lock_guard<std::mutex> guard(lock);
+
+        // Is the tile already in the cache?
+        auto it = tiles.find(t);
+        if(it != tiles.end()){
+          // Move it to the front of the queue...
+          lru.splice(lru.begin(), lru, it->second.second);
+          return it->second.first;
+        }
+
+        // If not, make some room...
+        if(tiles.size() >= capacity){
+          tiles.erase(lru.back());
+          lru.pop_back();
+        }
+
+        // ...and stick it on the tab.
+        lru.push_front(t);
+        auto& entry = tiles[t];
+        entry.first  = std::make_shared<Tile>();
+        entry.second = lru.begin();
+        return entry.first;
+      }
+
+      // Call fn with the bytes of the nominated tile (reading it from disk, if needed)...
+      template <typename F>
+      auto withTile(const std::size_t t, F fn){
+        std::shared_ptr<Tile> tile = pin(t);
+
+        // The first thread to get here reads the tile, while any others wanting it wait...
+        std::call_once(tile->read, [&](){
+          tile->bytes.resize(tileBytes);
+          std::size_t done = 0;
+          while(done < tileBytes){
+            ssize_t n = pread(fd, tile->bytes.data() + done, tileBytes - done, dataOffset + t*tileBytes + done);
+            if(n <= 0)
+              Exception("Unable to read tile " + std::to_string(t) + " from tiled file");
+            done += n;
+          }
+        });
+        return fn(tile->bytes.data());
+      }
+    };
+  } // utils
+} // oia_risk_model
+
+#endif //TILE_CACHE_H
@@ -2,9 +2,13 @@
 #define UTILS_H
 
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <cstdint>
 #include <algorithm>
 
 #include "exceptions.h"
@@ -44,54 +48,199 @@ namespace oia_risk_model {
       return l_s;
     }
 
-    // Helper function to read a line of delimited text into vector of strings, respecting any strings that may have delimiters in quotes...
-    std::vector<std::string> readLine(const std::string line, const char delim = ',', const bool stripQuotes = false){
-      std::stringstream ss(line);
+    // Helper function to append a number to a string as an ostream set to the given precision would write it (i.e. as printf's
+    // "%.*g"), without the cost of going through a stream...
+    inline void appendNumber(std::string& out, const double value, const int precision=6){
+      char buffer[64];
+      out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, precision).ptr);
+    }
 
-      // Create some space to store the words in the incoming line...
-      std::vector<std::string> words;
-      std::string              word;
-
-      // Parse the incoming line, respecting delims as requested...
-      while(std::getline(ss, word, delim)){
-        if(word.size() > 0){
-          // If needed, strip the quotes from a word...
-          if(stripQuotes)
-            word.erase(remove(word.begin(),word.end(), '\"' ),word.end());
-          // Stick it on the tab...
-          words.push_back(word);
-        }
+    // ...and the same for an integer.
+    inline void appendInteger(std::string& out, const long long value){
+      char buffer[24];
+      out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+    }
+
+    // Helper structure to walk the lines of a block of text (e.g. a mapped file) without copying them...
+    struct LineCursor{
+      const char* p;    // Start of the next line
+      const char* end;  // End of the text
+
+      LineCursor(const char* begin, const char* end) : p(begin), end(end) {}
+
+      // Has all of the text been read?
+      bool eof(void) const { return p >= end; }
+
+      // Get the next line (without its newline), returning false if there are no lines left...
+      bool next(std::string_view& line){
+        if(p >= end)
+          return false;
+
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if(!eol)
+          eol = end;
+
+        line = std::string_view(p, eol - p);
+        p = std::min(eol + 1, end);
+        return true;
+      }
+    };
+
+    // Helper function to find the first occurrence of either of two characters in [p, end), returning end if there is neither.
+    // The text is tested a word (eight bytes) at a time, flagging any byte equal to a or b with the usual "has a zero byte" trick
+    // (NOTE: flags above the first true match can be spurious, so only the lowest flag is used)...
+    inline const char* findEither(const char* p, const char* end, const char a, const char b){
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      const std::uint64_t ones  = 0x0101010101010101ull;
+      const std::uint64_t highs = 0x8080808080808080ull;
+      const std::uint64_t ma    = ones*static_cast<unsigned char>(a);
+      const std::uint64_t mb    = ones*static_cast<unsigned char>(b);
+      while(end - p >= 8){
+        std::uint64_t w;
+        std::memcpy(&w, p, 8);
+        const std::uint64_t xa = w ^ ma;
+        const std::uint64_t xb = w ^ mb;
+        const std::uint64_t hit = (((xa - ones) & ~xa) | ((xb - ones) & ~xb)) & highs;
+        if(hit)
+          return p + (__builtin_ctzll(hit) >> 3);
+        p += 8;
       }
+#endif
+      while(p < end && *p != a && *p != b)
+        p++;
+      return p;
+    }
+
+    // Helper function to split a line of delimited text into words without copying them (the words are views of the line), respecting
+    // any delimiters in quotes: empty words are skipped, and words are joined back together where a quote has been left open
+    // (NOTE: a joined word is the original text, delimiters and all)...
+    inline void splitLine(const std::string_view line, const char delim, std::vector<std::string_view>& words){
+      words.clear();
 
-      // Loop through the words, and check for any unhandled open-quotes which indicates delimters were included between quotes...
-      std::vector<std::string> fixedWords;
       // Flag to indicate we need to append neighboring words...
       bool append = false;
-      for(std::size_t i=0; i<words.size(); i++){
-        // Count the number of open-quotes in the string...
-        int numSQ=0, numDQ=0;
-        // Look for quotes...
-        for(auto c : words.at(i)){
-          if(c == '\'')
-            numSQ++;
-          if(c == '\"')
-            numDQ++;
+      const char* p   = line.data();
+      const char* end = p + line.size();
+      while(p < end){
+        // Find the end of the word...
+        const char* q = static_cast<const char*>(std::memchr(p, delim, end - p));
+        if(!q)
+          q = end;
+
+        if(q > p){
+          // Count the number of open-quotes in the word (jumping from quote to quote)...
+          int numSQ=0, numDQ=0;
+          for(const char* c=findEither(p, q, '\'', '\"'); c<q; c=findEither(c + 1, q, '\'', '\"')){
+            numSQ += (*c == '\'');
+            numDQ += (*c == '\"');
+          }
+
+          // Either extend the last word to take in this one, or start a new word...
+          if(append)
+            words.back() = std::string_view(words.back().data(), q - words.back().data());
+          else
+            words.emplace_back(p, q - p);
+
+          // Update the append flag for the next go around...
+          if(numDQ%2 != 0 || numSQ%2 != 0)
+            append = !append;
         }
 
-        // Append words if odd-numbers of any type of quote characters...
-        if(append){
-          fixedWords.at(fixedWords.size()-1) = fixedWords.at(fixedWords.size()-1) + "," + words.at(i);
-        } else {
-          fixedWords.push_back(words.at(i));
+        p = q + 1;
+      }
+    }
+
+    // Helper function to read a line of delimited text into vector of strings, respecting any strings that may have delimiters in
+    // quotes (as splitLine, but copying the words out). If the quotes are stripped, delimiters are no longer protected by them...
+    inline std::vector<std::string> readLine(const std::string_view line, const char delim = ',', const bool stripQuotes = false){
+      std::vector<std::string> words;
+      if(stripQuotes){
+        for(const char* p=line.data(), *end=p+line.size(); p<end; ){
+          const char* q = findEither(p, end, delim, delim);
+          if(q > p){
+            words.emplace_back(p, q);
+            words.back().erase(std::remove(words.back().begin(), words.back().end(), '\"'), words.back().end());
+          }
+          p = q + 1;
         }
+        return words;
+      }
 
-        // Update the append flag f or the next go around...
-        if(numDQ%2 != 0 || numSQ%2 != 0){
-          append = !append;
+      std::vector<std::string_view> views;
+      splitLine(line, delim, views);
+      for(auto v : views)
+        words.emplace_back(v);
+      return words;
+    }
+
+    // Helper function to split a row of delimited text (e.g. a line of a MID file) into fields without copying them (the fields
+    // are views of the line). Unlike splitLine, empty fields are kept (so every field lands in its column), only double quotes
+    // protect delimiters, and any carriage return at the end of the line is dropped...
+    inline void splitFields(std::string_view line, const char delim, std::vector<std::string_view>& fields){
+      fields.clear();
+      if(!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+      if(line.empty())
+        return;
+
+      // Jump from delimiter to delimiter (or, inside quotes, to the closing quote)...
+      const char* start  = line.data();
+      const char* end    = start + line.size();
+      bool        quoted = false;
+      for(const char* p=start; ; p++){
+        p = quoted ? findEither(p, end, '\"', '\"') : findEither(p, end, delim, '\"');
+        if(p == end)
+          break;
+        if(*p == '\"'){
+          quoted = !quoted;
+        }else{
+          fields.emplace_back(start, p - start);
+          start = p + 1;
         }
       }
+      fields.emplace_back(start, end - start);
+    }
+
+    // Helper function to parse a number from the start of a word (leading white space is skipped, as std::stod does)...
+    template <typename T>
+    inline T parseNumber(const std::string_view word){
+      const char* p   = word.data();
+      const char* end = p + word.size();
+      while(p < end && (*p == ' ' || *p == '\t'))
+        p++;
+
+      // from_chars doesn't accept a leading plus...
+      if(p < end && *p == '+')
+        p++;
+
+      T value;
+      auto result = std::from_chars(p, end, value);
+      if(result.ec != std::errc())
+        Exception("Unable to parse number (" + std::string(word) + ")");
+      return value;
+    }
+
+    // Helper function to parse a number that makes up the whole of a word (white space either side is skipped), returning false
+    // (and leaving value alone) if the word is anything else, e.g. "NULL", or "3.7" read as an integer...
+    template <typename T>
+    inline bool tryParseNumber(const std::string_view word, T& value){
+      const char* p   = word.data();
+      const char* end = p + word.size();
+      while(p < end && (*p == ' ' || *p == '\t'))
+        p++;
+      while(end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        end--;
+
+      // from_chars doesn't accept a leading plus...
+      if(p < end && *p == '+')
+        p++;
 
-      return fixedWords;
+      T v;
+      auto result = std::from_chars(p, end, v);
+      if(result.ec != std::errc() || result.ptr != end)
+        return false;
+      value = v;
+      return true;
     }
 
     // Inline helper method to write a data buffer to disk (NOTE: this is done to keep the memory footprint down for large study areas)...
@@ -105,12 +105,14 @@ namespace oia_risk_model{
         std::ifstream inFile;
         inFile.open(fileName);
 
-        std::string line;
-        std::string header;
+        std::string                   line;
+        std::string                   header;
+        std::vector<std::string_view> words;
 
         // Test the file is correctly formatted...
         std::getline(inFile,header);
-        std::vector<std::string> headerWords = utils::readLine(header);
+        std::vector<std::string_view> headerWords;
+        utils::splitLine(header, ',', headerWords);
 
         // Make sure the header is the correct format...
         if(headerWords.size() != 9){
@@ -121,16 +123,16 @@ namespace oia_risk_model{
         // Read the vehicles file line by line...
         while(!inFile.eof()){
           std::getline(inFile, line);
-          std::vector<std::string> words = utils::readLine(line);
+          utils::splitLine(line, ',', words);
 
           // If the line is the correct length, parse it out...
           if(words.size() == 9){
             std::vector<double> c;
             for(std::size_t i=2; i<words.size(); i++){
-              c.push_back(std::stod(words.at(i)));
+              c.push_back(utils::parseNumber<double>(words.at(i)));
             }
             // Insert the vehicle object into the std::map...
-            auto ret = CarFleet::vehicles.insert(std::pair<std::string,Vehicle*>(words.at(0), new Vehicle(std::stod(words.at(1)), c)));
+            auto ret = CarFleet::vehicles.insert(std::pair<std::string,Vehicle*>(std::string(words.at(0)), new Vehicle(utils::parseNumber<double>(words.at(1)), c)));
           }
         }
       }
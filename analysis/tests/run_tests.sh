@@ -0,0 +1,40 @@
+#!/bin/sh
+# Regression tests for the threaded paths of oia_risk_model. The checked-in assets are repeated (so the parsers and writers
+# split them into several chunks), run through thread_check on one thread and on several, and every output is compared...
+#   Usage: tests/run_tests.sh (or make test), with ARCH giving the target flags as for the Makefile.
+set -e
+
+tests=$(cd "$(dirname "$0")" && pwd)
+data="$tests/data"
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# Number of copies of the assets (the ordered writers work in chunks of 16384 features)...
+copies=500
+
+g++ -Wall "$tests/thread_check.cpp" -std=c++17 -O3 ${ARCH--march=native} -pthread -I"$tests/.." -o "$work/thread_check"
+
+# Repeat the body of the MIF (everything after "Data"), and the MID along with it...
+awk -v n=$copies 'body { b = b $0 "\n"; next } { print } /^Data/ { body = 1 } END { for(i=0; i<n; i++) printf "%s", b }' \
+  "$data/roads.mif" > "$work/roads.mif"
+awk -v n=$copies '{ b = b $0 "\n" } END { for(i=0; i<n; i++) printf "%s", b }' "$data/roads.mid" > "$work/roads.mid"
+
+# Run on one thread, which everything else is compared with...
+"$work/thread_check" "$work/roads" "$data/hazard.asc" "$data/fragility.csv" "$data/fragility_fine.csv" "$data/cost.csv" "$work/t1" 1
+
+failed=0
+for threads in 2 3 8; do
+  "$work/thread_check" "$work/roads" "$data/hazard.asc" "$data/fragility.csv" "$data/fragility_fine.csv" "$data/cost.csv" "$work/t$threads" $threads
+  for f in "$work"/t1_*; do
+    other="$work/t$threads${f#$work/t1}"
+    if ! cmp -s "$f" "$other"; then
+      echo "FAILED: $(basename "$other") differs from the single-threaded output"
+      failed=1
+    fi
+  done
+done
+
+if [ $failed -ne 0 ]; then
+  exit 1
+fi
+echo "All tests passed ($(ls "$work"/t1_* | wc -l) outputs compared on 2, 3 and 8 threads)"
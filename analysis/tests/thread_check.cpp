@@ -0,0 +1,199 @@
+#include <cmath>
+#include <limits>
+#include <string>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+
+// Import the MapInfo header file, which takes care of other imports
+#include "oia_risk_model/mif.h"
+#include "oia_risk_model/cell_risk.h"
+
+// Alias the imported namespace, to make it a little easier to use...
+namespace oia = oia_risk_model;
+
+
+// The original one-at-a-time fragility calculation, kept here (rather than calling FragilityCurve) so the kernel is checked against
+// something other than itself. The one change is that loads that aren't numbers get the first value, where this used to throw...
+double baselineProbability(const oia::fragility::FragilityCurve& f, const int CG, const double l){
+  if(!(l > f.minLoad))
+    return f.pFail.at(0);
+  if(CG < 1 ||  CG > f.numCG)
+    return 0;
+  int index = std::floor((l - f.minLoad) / f.deltaLoad);
+  if(l >= f.load.at(f.load.size()-1))
+    return f.pFail.at((f.numLoads-1)*f.numCG + (CG -1));
+  double lower = f.pFail.at(    index*f.numCG + (CG-1));
+  double upper = f.pFail.at((index+1)*f.numCG + (CG-1));
+  double A = 1 - (l - f.load.at(index)) / (f.load.at(index+1) - f.load.at(index));
+  return A*lower + (1 - A)*upper;
+}
+
+
+// Check the batch fragility kernel on a curve: at random loads off both ends of the curve with random CGs outside it, then at every
+// CG (0 and numCG+1 included) for each load in the file, halfway between them, just either side of both ends, infinite and not a
+// number. Returns the number of results that differ from the original formula, or from the one-at-a-time API...
+long checkFragility(const oia::fragility::FragilityCurve& f, std::mt19937& random){
+  long failures = 0;
+  const std::size_t   n = 10007;
+  std::vector<double> loads(n);
+  std::vector<int>    CG(n);
+  for(std::size_t i=0; i<n; i++){
+    loads[i] = f.minLoad - 0.5 + (f.maxLoad - f.minLoad + 1)*(random() / 4294967296.0);
+    CG[i]    = int(random() % (f.numCG + 2));
+  }
+  std::vector<double> edges = {std::nextafter(f.minLoad, -1e300), std::nextafter(f.minLoad, 1e300),
+                               std::nextafter(f.maxLoad, -1e300), std::nextafter(f.maxLoad, 1e300),
+                               std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                               std::numeric_limits<double>::quiet_NaN()};
+  for(int i=0; i<f.numLoads; i++){
+    edges.push_back(f.load[i]);
+    if(i+1 < f.numLoads)
+      edges.push_back(0.5*(f.load[i] + f.load[i+1]));
+  }
+  for(auto e : edges)
+    for(int cg=0; cg<=f.numCG+1; cg++){
+      loads.push_back(e);
+      CG.push_back(cg);
+    }
+
+  std::vector<double> batch(loads.size());
+  f.probabilities(CG.data(), loads.data(), loads.size(), batch.data());
+  for(std::size_t i=0; i<loads.size(); i++)
+    if(batch[i] != baselineProbability(f, CG[i], loads[i]) || f.probability(CG[i], loads[i]) != batch[i])
+      failures++;
+  return failures;
+}
+
+
+/*
+ * Regression check for the threaded paths of oia_risk_model. Runs a set of assets through the parallel parser, the ordered
+ * writers and the fragility calculations on the given number of threads, writing everything it produces under the output
+ * prefix (run_tests.sh compares the outputs of runs on different numbers of threads). The batch kernels are also checked
+ * against their one-at-a-time equivalents (the fragility kernel against the original formula), which doesn't depend on the threads.
+ */
+int main(int argc, char** argv){
+  ////////////////////////////////////////////////////////////
+  // 0. Preliminaries
+  if(argc != 8)
+    oia::Exception("The thread_check app needs to be called with seven arguments:\n"
+                   "   1. Existing MIF file of linear assets with flood_<year>_RP<rp> columns (without extension)\n"
+                   "   2. Existing ESRI Ascii raster of hazards\n"
+                   "   3. Fragility curve file\n"
+                   "   4. Second fragility curve file, with loads whose gaps aren't exact in binary (only used by the kernel checks)\n"
+                   "   5. Cost file\n"
+                   "   6. Prefix for the output files\n"
+                   "   7. Number of threads to use\n");
+
+  std::string mifFile       = std::string(argv[1]);
+  std::string asciiFile     = std::string(argv[2]);
+  std::string fragilityFile     = std::string(argv[3]);
+  std::string fineFragilityFile = std::string(argv[4]);
+  std::string costFile          = std::string(argv[5]);
+  std::string prefix            = std::string(argv[6]);
+  int         threads           = oia::utils::parseNumber<int>(argv[7]);
+
+
+  ////////////////////////////////////////////////////////////
+  // 1. Parse the assets and raster, and write them straight back out
+  oia::Ascii hazard(asciiFile, false, threads);
+  {
+    oia::MIF assets(mifFile, false, threads);
+    assets.write(prefix + "_parsed", false, threads);
+
+    // ...then add the exposure statistics.
+    std::vector<oia::CellLength> cellLengths;
+    assets.addExposureStatistics(hazard, "hazard", {0.5, 1}, &cellLengths, threads);
+    assets.write(prefix + "_stats", false, threads);
+
+    std::ofstream cellFile(prefix + "_cell_lengths.csv");
+    cellFile << std::setprecision(17);
+    for(auto c : cellLengths)
+      cellFile << c.feature << "," << c.cell << "," << c.lengthKm << "\n";
+  }
+
+
+  ////////////////////////////////////////////////////////////
+  // 2. Divide the assets onto the raster, and write them out (merging the divided features back up, too)
+  {
+    oia::MIF assets(mifFile, false, threads);
+    assets.divideFeatures(hazard, true, threads);
+    assets.write(prefix + "_divided", false, threads);
+    assets.writeMID(prefix + "_merged", "MEAN", threads);
+  }
+
+
+  ////////////////////////////////////////////////////////////
+  // 3. Calculate the fragility of the assets, and of every cell of the raster
+  oia::fragility::FragilityCurve   f(fragilityFile, true);
+  oia::fragility::CostFunction     cf = oia::fragility::readCostFile(costFile);
+  {
+    oia::MIF assets(mifFile, false, threads);
+    oia::addRoadFragility(assets, f, cf, prefix + "_fragility", false, threads);
+  }
+
+  oia::RasterStack hazards({{asciiFile, "flood_RP10"}, {asciiFile, "flood_RP100"}}, false, threads);
+  oia::CellRisk    risk(hazards, f, {10, 100}, threads);
+  {
+    std::ofstream riskFile(prefix + "_cell_risk.csv");
+    riskFile << std::setprecision(9);
+    for(auto a : risk.annual)
+      riskFile << a << "\n";
+  }
+
+
+  ////////////////////////////////////////////////////////////
+  // 4. Check the batch kernels against their one-at-a-time equivalents
+  long failures = 0;
+  std::mt19937 random(13);
+
+  // Fragility, on the curve used above and on one whose load gaps aren't exact in binary (so dividing by them differs from
+  // multiplying by their reciprocals)...
+  failures += checkFragility(f, random) + checkFragility(oia::fragility::FragilityCurve(fineFragilityFile, true), random);
+
+  // ...areas under the RP curve: Graph takes the RPs in column order (shortest first), areas the other way around...
+  for(int it=0; it<2000; it++){
+    std::size_t         numPoints = 1 + random() % 5;
+    std::vector<int>    rp;
+    std::vector<double> pFail;
+    for(std::size_t p=0, v=1 + random() % 3; p<numPoints; p++, v*=2 + random() % 5){
+      rp.push_back(v);
+      pFail.push_back(random() % 3 == 0 ? 1.0 : random() / 4294967296.0);
+    }
+
+    std::vector<double>        X;
+    std::vector<const double*> Y;
+    for(std::size_t p=numPoints; p-- > 0; ){
+      X.push_back(1.0/double(rp[p]));
+      Y.push_back(&pFail[p]);
+    }
+    double area;
+    oia::fragility::areas(X.data(), Y.data(), numPoints, 1, &area);
+    if(area != oia::fragility::Graph(rp, pFail).area())
+      failures++;
+  }
+
+  // ...and the annual probability of failure, a point at a time and in a batch (including points off the raster and CGs outside
+  // the curve).
+  const std::size_t                        n = 10007;
+  std::vector<oia::geometry::Vec2<double>> points(n);
+  std::vector<int>                         CG(n);
+  std::vector<double>                      annual(n);
+  for(std::size_t i=0; i<n; i++){
+    points[i] = oia::geometry::Vec2<double>(hazard.xll - 0.05 + (hazard.ncols*hazard.cellsize + 0.1)*(random() / 4294967296.0),
+                                            hazard.yll - 0.05 + (hazard.nrows*hazard.cellsize + 0.1)*(random() / 4294967296.0));
+    CG[i]     = int(random() % (f.numCG + 2));
+  }
+  risk.annualProbabilities(points.data(), CG.data(), n, annual.data());
+  for(std::size_t i=0; i<n; i++)
+    if(annual[i] != risk.annualProbability(points[i], CG[i]))
+      failures++;
+
+  if(failures > 0){
+    std::cout << "FAILED: " << failures << " batch kernel results differ from the one-at-a-time results\n";
+    return 1;
+  }
+
+  return 0;
+}